@@ -4,7 +4,26 @@ CONFIG -= app_bundle
 CONFIG -= qt
 
 SOURCES += \
-    pong.cpp
+    pong.cpp \
+    pong_shm.c \
+    capture.cpp \
+    softrender.cpp \
+    analytics.cpp \
+    matchlog.cpp \
+    checkpoint.cpp \
+    harness.cpp
+
+HEADERS += \
+    pong_shm.h \
+    capture.h \
+    softrender.h \
+    analytics.h \
+    matchlog.h \
+    checkpoint.h \
+    harness.h
+
+# shm_open lives in librt on older glibc
+unix: LIBS += -lrt
 
 # Command
 # -L[Directory path of "lib" folder] -lSDL2
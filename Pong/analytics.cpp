@@ -0,0 +1,180 @@
+/*
+Streaming match analytics.
+*/
+
+#include "analytics.h"
+
+#include <SDL_thread.h>
+#include <time.h>
+using namespace std;
+
+MatchAnalytics::MatchAnalytics()
+{
+    //Initialize
+    mHead = 0;
+    mTail = 0;
+    mActive = false;
+    mDropped = 0;
+    mWritten = 0;
+    mFile = NULL;
+    mThread = NULL;
+    mStopping = false;
+}
+
+MatchAnalytics::~MatchAnalytics()
+{
+    //Flush and close
+    stop();
+}
+
+bool MatchAnalytics::start( string path )
+{
+    //Get rid of a previous log
+    stop();
+
+    mFile = fopen( path.c_str(), "wb" );
+    if( mFile == NULL )
+    {
+        printf( "Unable to create match log %s!\n", path.c_str() );
+        return false;
+    }
+
+    MatchLogHeader header;
+    header.magic = MATCHLOG_MAGIC;
+    header.version = MATCHLOG_VERSION;
+    header.startTime = (uint64_t)time( NULL );
+    if( fwrite( &header, sizeof( header ), 1, mFile ) != 1 )
+    {
+        printf( "Unable to write match log %s!\n", path.c_str() );
+        fclose( mFile );
+        mFile = NULL;
+        return false;
+    }
+
+    mHead = 0;
+    mTail = 0;
+    mDropped = 0;
+    mWritten = 0;
+    mPending.clear();
+    mPending.reserve( ROWS_PER_GROUP );
+    mStopping = false;
+
+    mThread = SDL_CreateThread( writerThread, "MatchAnalytics", this );
+    if( mThread == NULL )
+    {
+        printf( "Unable to start match log writer! SDL Error: %s\n", SDL_GetError() );
+        fclose( mFile );
+        mFile = NULL;
+        return false;
+    }
+
+    mActive = true;
+    return true;
+}
+
+void MatchAnalytics::stop()
+{
+    mActive = false;
+
+    //Let the writer flush what is queued
+    if( mThread != NULL )
+    {
+        mStopping = true;
+        SDL_WaitThread( mThread, NULL );
+        mThread = NULL;
+
+        printf( "Analytics: %u events written, %u dropped\n", mWritten.load(), mDropped );
+    }
+
+    if( mFile != NULL )
+    {
+        fclose( mFile );
+        mFile = NULL;
+    }
+}
+
+bool MatchAnalytics::isActive()
+{
+    return mActive;
+}
+
+Uint32 MatchAnalytics::getDropped()
+{
+    return mDropped;
+}
+
+Uint32 MatchAnalytics::getWritten()
+{
+    return mWritten.load();
+}
+
+int MatchAnalytics::writerThread( void* data )
+{
+    MatchAnalytics* analytics = (MatchAnalytics*)data;
+
+    for( ;; )
+    {
+        //Read the flag first so nothing queued before stop() is missed
+        bool stopping = analytics->mStopping;
+
+        if( !analytics->drain() )
+        {
+            if( stopping )
+            {
+                break;
+            }
+            SDL_Delay( IDLE_DELAY_MS );
+        }
+    }
+
+    //Last partial row group
+    analytics->writeGroup();
+    fflush( analytics->mFile );
+
+    return 0;
+}
+
+bool MatchAnalytics::drain()
+{
+    Uint32 tail = mTail.load( memory_order_relaxed );
+    Uint32 head = mHead.load( memory_order_acquire );
+    if( tail == head )
+    {
+        return false;
+    }
+
+    for( ; tail != head; ++tail )
+    {
+        mPending.push_back( mQueue[ tail & ( QUEUE_SIZE - 1 ) ] );
+        if( mPending.size() == ROWS_PER_GROUP )
+        {
+            //Free the slots before the slow part
+            mTail.store( tail + 1, memory_order_release );
+            writeGroup();
+        }
+    }
+    mTail.store( tail, memory_order_release );
+
+    return true;
+}
+
+bool MatchAnalytics::writeGroup()
+{
+    if( mPending.empty() )
+    {
+        return true;
+    }
+
+    bool success = matchLogWriteGroup( mFile, &mPending[ 0 ], (uint32_t)mPending.size(), mScratch );
+    if( !success )
+    {
+        printf( "Unable to write match log!\n" );
+    }
+    else
+    {
+        mWritten += (Uint32)mPending.size();
+    }
+
+    mPending.clear();
+    return success;
+}
@@ -0,0 +1,100 @@
+/*
+Streaming match analytics.
+
+The game thread drops MatchEvents into a lock-free single-producer ring and
+a background thread drains it into a columnar match log. Logging an event
+is a handful of stores; when the ring is full the event is counted and
+dropped rather than making the game wait.
+*/
+
+#ifndef ANALYTICS_H
+#define ANALYTICS_H
+
+#include <SDL.h>
+#include <stdio.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include "matchlog.h"
+
+//Match analytics wrapper class
+class MatchAnalytics
+{
+    public:
+        //Events the ring holds, must be a power of two
+        static const Uint32 QUEUE_SIZE = 4096;
+
+        //Rows per row group in the log
+        static const Uint32 ROWS_PER_GROUP = 4096;
+
+        //How long the writer sleeps when the ring is empty
+        static const Uint32 IDLE_DELAY_MS = 5;
+
+        //Initializes variables
+        MatchAnalytics();
+
+        //Stops logging
+        ~MatchAnalytics();
+
+        //Creates the log file and starts the writer thread
+        bool start( std::string path );
+
+        //Queues an event, never blocks
+        void logEvent( const MatchEvent& event )
+        {
+            if( !mActive )
+            {
+                return;
+            }
+
+            Uint32 head = mHead.load( std::memory_order_relaxed );
+            if( head - mTail.load( std::memory_order_acquire ) == QUEUE_SIZE )
+            {
+                mDropped++;
+                return;
+            }
+
+            mQueue[ head & ( QUEUE_SIZE - 1 ) ] = event;
+            mHead.store( head + 1, std::memory_order_release );
+        }
+
+        //Writes what is queued and closes the log
+        void stop();
+
+        //Checks if events are being logged
+        bool isActive();
+
+        //Events dropped because the writer fell behind
+        Uint32 getDropped();
+
+        //Events written to the log
+        Uint32 getWritten();
+
+    private:
+        //Writer thread entry point
+        static int writerThread( void* data );
+
+        //Moves queued events into the pending row group
+        bool drain();
+
+        //Writes the pending row group
+        bool writeGroup();
+
+        //Event ring, head and tail on their own cache lines
+        MatchEvent mQueue[ QUEUE_SIZE ];
+        alignas( 64 ) std::atomic<Uint32> mHead;
+        alignas( 64 ) std::atomic<Uint32> mTail;
+        alignas( 64 ) bool mActive;
+        Uint32 mDropped;
+
+        //Rows waiting to be written, owned by the writer thread
+        std::vector<MatchEvent> mPending;
+        std::vector<uint8_t> mScratch;
+        std::atomic<Uint32> mWritten;
+
+        FILE* mFile;
+        SDL_Thread* mThread;
+        std::atomic<bool> mStopping;
+};
+
+#endif
@@ -0,0 +1,90 @@
+/*
+Game-thread cost of logging a match-analytics event.
+
+Events are queued in bursts the size of a busy rally with the writer
+thread draining the queue into a real log, and only the time spent in
+logEvent is counted. A second pass floods the queue to time the dropped
+path as well.
+*/
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../analytics.h"
+
+#ifdef __MINGW32__
+#undef main /* Prevents SDL from overriding main() */
+#endif
+
+const int BURSTS = 2000;
+const int BURST_EVENTS = 256;
+const int FLOOD_EVENTS = 1000000;
+
+//Keeps the analytics object off the stack
+MatchAnalytics gAnalytics;
+
+MatchEvent makeEvent( Uint32 tick )
+{
+    MatchEvent event;
+    event.tick = tick;
+    event.type = tick % 3;
+    event.player = 1 + tick % 2;
+    event.ballX = tick % 800;
+    event.ballY = tick % 600;
+    event.ballVelX = 10;
+    event.ballVelY = -7;
+    event.contactOffset = (int)( tick % 110 ) - 55;
+    event.rallyLength = tick % 20;
+    return event;
+}
+
+int main( int argc, char* args[] )
+{
+    const char* path = argc > 1 ? args[ 1 ] : "analytics_bench.pma";
+
+    if( SDL_Init( SDL_INIT_TIMER ) < 0 )
+    {
+        printf( "SDL could not initialize! SDL Error: %s\n", SDL_GetError() );
+        return 1;
+    }
+
+    if( !gAnalytics.start( path ) )
+    {
+        return 1;
+    }
+
+    //Bursts the writer keeps up with
+    Uint64 total = 0;
+    Uint32 tick = 0;
+    for( int burst = 0; burst < BURSTS; ++burst )
+    {
+        Uint64 start = SDL_GetPerformanceCounter();
+        for( int i = 0; i < BURST_EVENTS; ++i, ++tick )
+        {
+            gAnalytics.logEvent( makeEvent( tick ) );
+        }
+        total += SDL_GetPerformanceCounter() - start;
+
+        SDL_Delay( 1 );
+    }
+    double queued = total * 1e9 / SDL_GetPerformanceFrequency() / ( BURSTS * BURST_EVENTS );
+    Uint32 droppedBefore = gAnalytics.getDropped();
+
+    //Flood it so most events take the dropped path
+    Uint64 start = SDL_GetPerformanceCounter();
+    for( int i = 0; i < FLOOD_EVENTS; ++i, ++tick )
+    {
+        gAnalytics.logEvent( makeEvent( tick ) );
+    }
+    double flooded = ( SDL_GetPerformanceCounter() - start ) * 1e9 / SDL_GetPerformanceFrequency() / FLOOD_EVENTS;
+    Uint32 dropped = gAnalytics.getDropped() - droppedBefore;
+
+    gAnalytics.stop();
+    SDL_Quit();
+
+    printf( "logEvent in bursts  %.1f ns/event (%d events, %u dropped)\n", queued, BURSTS * BURST_EVENTS, droppedBefore );
+    printf( "logEvent flooded    %.1f ns/event (%d events, %u dropped)\n", flooded, FLOOD_EVENTS, dropped );
+    printf( "budget              100 ns/event, %s\n", queued < 100.0 && flooded < 100.0 ? "met" : "MISSED" );
+
+    return 0;
+}
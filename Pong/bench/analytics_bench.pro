@@ -0,0 +1,20 @@
+TEMPLATE = app
+CONFIG += console c++11
+CONFIG -= app_bundle
+CONFIG -= qt
+
+SOURCES += \
+    analytics_bench.cpp \
+    ../analytics.cpp \
+    ../matchlog.cpp
+
+HEADERS += \
+    ../analytics.h \
+    ../matchlog.h
+
+# Command
+# -L[Directory path of "lib" folder] -lSDL2
+LIBS += -LC://SDL2_libs/SDL2-2.0.5//i686-w64-mingw32//lib -lSDL2
+
+# [Directory of "include"]
+INCLUDEPATH += C://SDL2_libs/SDL2-2.0.5//i686-w64-mingw32//include//SDL2
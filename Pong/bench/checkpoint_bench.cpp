@@ -0,0 +1,236 @@
+/*
+Cost of checkpointing many matches and of resuming them.
+
+Runs MATCHES matches side by side with the game's ball and paddle rules, a
+quarter of them sitting between points, and checkpoints them like the game
+does: every tick compares one of CHECKPOINT_TICKS slices of the matches.
+Like the game, every match's tick advances each frame but is left out of
+the comparison, so the paused matches are never written again. The journal
+is kept at its smallest size so the run rolls over to the other file many
+times. Ticks are paced at 60 Hz, so the journal's writer thread gets the
+rest of each frame the way it does in the game, and the mean, p99 and worst
+checkpoint time per tick are compared with that budget. A fresh journal has to restore nothing, and after the run
+one last checkpoint covers every match, the journal is reopened and every
+match restored and compared, tick aside.
+*/
+
+#include <SDL.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "../checkpoint.h"
+using namespace std;
+
+#ifdef __MINGW32__
+#undef main /* Prevents SDL from overriding main() */
+#endif
+
+const int MATCHES = 10000;
+const int TICKS = 1800;
+const Uint32 CHECKPOINT_TICKS = 60;
+
+//Below the minimum, so the journal picks the smallest size it allows
+const uint64_t JOURNAL_CAPACITY = 0;
+
+//One 60 Hz frame
+const double TICK_BUDGET_MS = 1000.0 / 60.0;
+
+const int SCREEN_WIDTH = 800;
+const int SCREEN_HEIGHT = 600;
+const int PADDLE_HEIGHT = 110;
+const int BALL_SIZE = 20;
+const int BALL_SPEED = 10;
+
+//Same layout as Match in pong.cpp
+struct BenchMatch
+{
+    //Paddle
+    int velY_P1, velY_P2;
+    int velX_P1, velX_P2;
+    bool moving_P1, moving_P2;
+    SDL_Rect pad_P1, pad_P2;
+
+    //Ball
+    int ballXVel, ballYVel;
+    SDL_Rect ball;
+
+    int player1_score;
+    int player2_score;
+    bool p1_scored;
+    bool p2_scored;
+    int rallyLength;
+
+    //Last, left out of the comparison
+    Uint32 tick;
+};
+
+//Everything but tick
+const uint32_t COMPARE_SIZE = offsetof( BenchMatch, tick );
+
+void resetMatch( BenchMatch& match, int seed )
+{
+    memset( &match, 0, sizeof( match ) );
+    match.pad_P1.x = 10;
+    match.pad_P2.x = SCREEN_WIDTH - 20;
+    match.pad_P1.y = match.pad_P2.y = ( SCREEN_HEIGHT - PADDLE_HEIGHT ) / 2;
+    match.pad_P1.w = match.pad_P2.w = 10;
+    match.pad_P1.h = match.pad_P2.h = PADDLE_HEIGHT;
+    match.ball.x = SCREEN_WIDTH / 2 + seed % 200 - 100;
+    match.ball.y = SCREEN_HEIGHT / 2 + seed % 150 - 75;
+    match.ball.w = match.ball.h = BALL_SIZE;
+
+    //Every fourth match waits for a serve and never changes
+    if( seed % 4 != 0 )
+    {
+        match.ballXVel = seed % 2 ? BALL_SPEED : -BALL_SPEED;
+        match.ballYVel = seed % 3 ? 7 : -7;
+    }
+}
+
+//One tick of the game's ball and paddle rules
+void stepMatch( BenchMatch& match )
+{
+    //The game counts ticks whether the ball moves or not
+    match.tick++;
+    if( match.ballXVel == 0 )
+    {
+        return;
+    }
+
+    match.ball.x += match.ballXVel;
+    match.ball.y += match.ballYVel;
+    if( match.ball.y < 0 || match.ball.y + BALL_SIZE > SCREEN_HEIGHT )
+    {
+        match.ballYVel = -match.ballYVel;
+        match.ball.y += match.ballYVel;
+    }
+
+    //Paddles chase the ball
+    int target = match.ball.y + BALL_SIZE / 2 - PADDLE_HEIGHT / 2;
+    match.velY_P1 = target > match.pad_P1.y ? 10 : -10;
+    match.velY_P2 = target > match.pad_P2.y ? 10 : -10;
+    match.pad_P1.y += match.velY_P1;
+    match.pad_P2.y += match.velY_P2;
+
+    if( match.ball.x < match.pad_P1.x + match.pad_P1.w || match.ball.x + BALL_SIZE > match.pad_P2.x )
+    {
+        match.ballXVel = -match.ballXVel;
+        match.rallyLength++;
+    }
+}
+
+double elapsedMs( Uint64 start )
+{
+    return ( SDL_GetPerformanceCounter() - start ) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+int main( int argc, char* args[] )
+{
+    const char* path = argc > 1 ? args[ 1 ] : "checkpoint_bench.journal";
+
+    if( SDL_Init( SDL_INIT_TIMER ) < 0 )
+    {
+        printf( "SDL could not initialize! SDL Error: %s\n", SDL_GetError() );
+        return 1;
+    }
+
+    //Start from scratch
+    string base = path;
+    remove( ( base + ".0" ).c_str() );
+    remove( ( base + ".1" ).c_str() );
+
+    vector<BenchMatch> matches( MATCHES );
+    for( int i = 0; i < MATCHES; ++i )
+    {
+        resetMatch( matches[ i ], i );
+    }
+
+    MatchJournal journal;
+    Uint64 start = SDL_GetPerformanceCounter();
+    if( !journal.open( path, sizeof( BenchMatch ), MATCHES, JOURNAL_CAPACITY, COMPARE_SIZE ) )
+    {
+        return 1;
+    }
+    double openMs = elapsedMs( start );
+
+    //A new journal has nothing to resume, restoring must leave the matches alone
+    vector<BenchMatch> fresh( matches );
+    Uint32 freshCount = journal.restore( &fresh[ 0 ] );
+    bool freshUntouched = freshCount == 0 && memcmp( &fresh[ 0 ], &matches[ 0 ], sizeof( BenchMatch ) * MATCHES ) == 0;
+
+    double simMs = 0.0;
+    vector<double> checkpointMs;
+    checkpointMs.reserve( TICKS );
+    Uint64 written = 0;
+    Uint64 runStart = SDL_GetPerformanceCounter();
+    for( int tick = 1; tick <= TICKS; ++tick )
+    {
+        start = SDL_GetPerformanceCounter();
+        for( int i = 0; i < MATCHES; ++i )
+        {
+            stepMatch( matches[ i ] );
+        }
+        simMs += elapsedMs( start );
+
+        start = SDL_GetPerformanceCounter();
+        written += journal.checkpoint( &matches[ 0 ], tick % CHECKPOINT_TICKS, CHECKPOINT_TICKS );
+        checkpointMs.push_back( elapsedMs( start ) );
+
+        //Sleep out the rest of the frame
+        double aheadMs = tick * TICK_BUDGET_MS - elapsedMs( runStart );
+        if( aheadMs >= 1.0 )
+        {
+            SDL_Delay( (Uint32)aheadMs );
+        }
+    }
+    Uint64 generation = journal.getGeneration();
+
+    //Catch the slices that moved since they were compared
+    journal.checkpoint( &matches[ 0 ] );
+    journal.close();
+
+    //Resume every match and check nothing was lost
+    vector<BenchMatch> restored( MATCHES );
+    start = SDL_GetPerformanceCounter();
+    if( !journal.open( path, sizeof( BenchMatch ), MATCHES, JOURNAL_CAPACITY, COMPARE_SIZE ) )
+    {
+        return 1;
+    }
+    Uint32 count = journal.restore( &restored[ 0 ] );
+    double restoreMs = elapsedMs( start );
+    journal.close();
+
+    //A paused match keeps the tick it was last written at
+    bool same = count == MATCHES;
+    for( int i = 0; i < MATCHES && same; ++i )
+    {
+        same = memcmp( &matches[ i ], &restored[ i ], COMPARE_SIZE ) == 0;
+    }
+
+    SDL_Quit();
+
+    sort( checkpointMs.begin(), checkpointMs.end() );
+    double perTick = 0.0;
+    for( size_t i = 0; i < checkpointMs.size(); ++i )
+    {
+        perTick += checkpointMs[ i ];
+    }
+    perTick /= TICKS;
+    double p99 = checkpointMs[ checkpointMs.size() * 99 / 100 ];
+    double worst = checkpointMs.back();
+    double worstPct = worst * 100.0 / TICK_BUDGET_MS;
+
+    printf( "matches             %d x %u bytes, %u compared\n", MATCHES, (unsigned)sizeof( BenchMatch ), COMPARE_SIZE );
+    printf( "simulation          %.3f ms/tick\n", simMs / TICKS );
+    printf( "checkpoint          %.4f ms/tick mean, %.4f ms p99, %.4f ms worst, %llu records, %llu generations\n", perTick, p99, worst, (unsigned long long)written, (unsigned long long)generation );
+    printf( "tick budget         %.2f%% mean, %.2f%% p99, %.2f%% worst, %.1f%% of simulation\n", perTick * 100.0 / TICK_BUDGET_MS, p99 * 100.0 / TICK_BUDGET_MS, worstPct, perTick * 100.0 / ( simMs / TICKS ) );
+    printf( "open                %.2f ms, fresh journal restored %u matches, %s\n", openMs, freshCount, freshUntouched ? "untouched" : "CLOBBERED" );
+    printf( "restore             %.2f ms, %u matches, %s\n", restoreMs, count, same ? "identical" : "MISMATCH" );
+    printf( "budget              1%% of every tick, %s\n", worstPct < 1.0 && same ? "met" : "MISSED" );
+
+    return same && freshUntouched ? 0 : 1;
+}
@@ -0,0 +1,18 @@
+TEMPLATE = app
+CONFIG += console c++11
+CONFIG -= app_bundle
+CONFIG -= qt
+
+SOURCES += \
+    checkpoint_bench.cpp \
+    ../checkpoint.cpp
+
+HEADERS += \
+    ../checkpoint.h
+
+# Command
+# -L[Directory path of "lib" folder] -lSDL2
+LIBS += -LC://SDL2_libs/SDL2-2.0.5//i686-w64-mingw32//lib -lSDL2
+
+# [Directory of "include"]
+INCLUDEPATH += C://SDL2_libs/SDL2-2.0.5//i686-w64-mingw32//include//SDL2
@@ -0,0 +1,215 @@
+/*
+Frame time of the CPU render backend against SDL's software renderer.
+
+Both draw the game's frame (clear, background, dotted centre line, paddles
+and a moving ball) at 800x600 and 3840x2160. The background is tiled to
+fill the larger screen. The CPU backend's time includes its streaming
+texture upload and the copy onto the presenting renderer.
+*/
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "../softrender.h"
+using namespace std;
+
+#ifdef __MINGW32__
+#undef main /* Prevents SDL from overriding main() */
+#endif
+
+const int WARMUP_FRAMES = 30;
+const int FRAMES = 300;
+
+//Same sprite layout as the game's sprites.png
+const SDL_Rect P1_CLIP = { 20, 20, 10, 130 };
+const SDL_Rect P2_CLIP = { 70, 20, 10, 130 };
+const SDL_Rect BALL_CLIP = { 115, 15, 20, 20 };
+
+//Synthetic stand-ins for the game's images
+SDL_Surface* makeBackground()
+{
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat( 0, 800, 600, 32, SDL_PIXELFORMAT_ARGB8888 );
+    for( int y = 0; y < surface->h; ++y )
+    {
+        Uint32* row = (Uint32*)( (Uint8*)surface->pixels + y * surface->pitch );
+        for( int x = 0; x < surface->w; ++x )
+        {
+            row[ x ] = 0xFF000000 | ( ( x * 255 / surface->w ) << 16 ) | ( ( y * 255 / surface->h ) << 8 ) | 0x40;
+        }
+    }
+    return surface;
+}
+
+SDL_Surface* makeSprites()
+{
+    //Everything outside the sprites is the game's color key
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat( 0, 150, 160, 32, SDL_PIXELFORMAT_ARGB8888 );
+    for( int y = 0; y < surface->h; ++y )
+    {
+        Uint32* row = (Uint32*)( (Uint8*)surface->pixels + y * surface->pitch );
+        for( int x = 0; x < surface->w; ++x )
+        {
+            row[ x ] = 0xFFFFE3A0;
+        }
+    }
+
+    const SDL_Rect* clips[] = { &P1_CLIP, &P2_CLIP, &BALL_CLIP };
+    for( int i = 0; i < 3; ++i )
+    {
+        SDL_Rect clip = *clips[ i ];
+        SDL_FillRect( surface, &clip, 0xFFFFFFFF );
+    }
+
+    SDL_SetColorKey( surface, SDL_TRUE, SDL_MapRGB( surface->format, 0xFF, 0xE3, 0xA0 ) );
+    return surface;
+}
+
+//Where the ball is on a given frame
+void ballPosition( int frame, int width, int height, int& x, int& y )
+{
+    x = ( frame * 7 ) % ( width - BALL_CLIP.w );
+    y = ( frame * 5 ) % ( height - BALL_CLIP.h );
+}
+
+double benchSDL( int width, int height, SDL_Surface* background, SDL_Surface* sprites )
+{
+    SDL_Surface* target = SDL_CreateRGBSurfaceWithFormat( 0, width, height, 32, SDL_PIXELFORMAT_ARGB8888 );
+    SDL_Renderer* renderer = SDL_CreateSoftwareRenderer( target );
+    SDL_Texture* backgroundTexture = SDL_CreateTextureFromSurface( renderer, background );
+    SDL_Texture* spriteTexture = SDL_CreateTextureFromSurface( renderer, sprites );
+
+    Uint64 total = 0;
+    for( int frame = 0; frame < WARMUP_FRAMES + FRAMES; ++frame )
+    {
+        Uint64 start = SDL_GetPerformanceCounter();
+
+        SDL_SetRenderDrawColor( renderer, 0x00, 0x00, 0x00, 0xFF );
+        SDL_RenderClear( renderer );
+
+        for( int y = 0; y < height; y += background->h )
+        {
+            for( int x = 0; x < width; x += background->w )
+            {
+                SDL_Rect quad = { x, y, background->w, background->h };
+                SDL_RenderCopy( renderer, backgroundTexture, NULL, &quad );
+            }
+        }
+
+        SDL_SetRenderDrawColor( renderer, 0xFF, 0xFF, 0xFF, 0xFF );
+        for( int i = 0; i < height; i += 4 )
+        {
+            SDL_RenderDrawPoint( renderer, width / 2, i );
+        }
+
+        SDL_Rect p1 = { 0, height / 2 - 55, P1_CLIP.w, P1_CLIP.h };
+        SDL_Rect p2 = { width - P2_CLIP.w, height / 2 - 55, P2_CLIP.w, P2_CLIP.h };
+        SDL_Rect ball = { 0, 0, BALL_CLIP.w, BALL_CLIP.h };
+        ballPosition( frame, width, height, ball.x, ball.y );
+        SDL_RenderCopy( renderer, spriteTexture, &P1_CLIP, &p1 );
+        SDL_RenderCopy( renderer, spriteTexture, &P2_CLIP, &p2 );
+        SDL_RenderCopy( renderer, spriteTexture, &BALL_CLIP, &ball );
+
+        SDL_RenderPresent( renderer );
+
+        if( frame >= WARMUP_FRAMES )
+        {
+            total += SDL_GetPerformanceCounter() - start;
+        }
+    }
+
+    SDL_DestroyTexture( spriteTexture );
+    SDL_DestroyTexture( backgroundTexture );
+    SDL_DestroyRenderer( renderer );
+    SDL_FreeSurface( target );
+
+    return total * 1000.0 / SDL_GetPerformanceFrequency() / FRAMES;
+}
+
+double benchCPU( int width, int height, int threads, SDL_Surface* background, SDL_Surface* sprites )
+{
+    SDL_Surface* target = SDL_CreateRGBSurfaceWithFormat( 0, width, height, 32, SDL_PIXELFORMAT_ARGB8888 );
+    SDL_Renderer* presenter = SDL_CreateSoftwareRenderer( target );
+
+    SoftRenderer renderer;
+    renderer.init( presenter, width, height, threads );
+
+    SoftImage backgroundImage;
+    SoftImage spriteImage;
+    backgroundImage.loadFromSurface( background );
+    spriteImage.loadFromSurface( sprites );
+
+    Uint64 total = 0;
+    for( int frame = 0; frame < WARMUP_FRAMES + FRAMES; ++frame )
+    {
+        Uint64 start = SDL_GetPerformanceCounter();
+
+        renderer.clear( 0x00, 0x00, 0x00 );
+
+        for( int y = 0; y < height; y += background->h )
+        {
+            for( int x = 0; x < width; x += background->w )
+            {
+                renderer.blit( &backgroundImage, x, y );
+            }
+        }
+
+        for( int i = 0; i < height; i += 4 )
+        {
+            SDL_Rect dot = { width / 2, i, 1, 1 };
+            renderer.fillRect( dot, 0xFF, 0xFF, 0xFF );
+        }
+
+        int ballX, ballY;
+        ballPosition( frame, width, height, ballX, ballY );
+        renderer.blit( &spriteImage, 0, height / 2 - 55, &P1_CLIP );
+        renderer.blit( &spriteImage, width - P2_CLIP.w, height / 2 - 55, &P2_CLIP );
+        renderer.blit( &spriteImage, ballX, ballY, &BALL_CLIP );
+
+        renderer.flush();
+        SDL_RenderPresent( presenter );
+
+        if( frame >= WARMUP_FRAMES )
+        {
+            total += SDL_GetPerformanceCounter() - start;
+        }
+    }
+
+    renderer.free();
+    SDL_DestroyRenderer( presenter );
+    SDL_FreeSurface( target );
+
+    return total * 1000.0 / SDL_GetPerformanceFrequency() / FRAMES;
+}
+
+int main( int argc, char* args[] )
+{
+    int threads = argc > 1 ? atoi( args[ 1 ] ) : SDL_GetCPUCount();
+
+    if( SDL_Init( 0 ) < 0 )
+    {
+        printf( "SDL could not initialize! SDL Error: %s\n", SDL_GetError() );
+        return 1;
+    }
+
+    SDL_Surface* background = makeBackground();
+    SDL_Surface* sprites = makeSprites();
+
+    const int sizes[][ 2 ] = { { 800, 600 }, { 3840, 2160 } };
+    printf( "mean frame time (ms), CPU backend on %d threads\n", threads );
+    printf( "%-10s %10s %10s %10s\n", "size", "SDL soft", "CPU", "speedup" );
+    for( int i = 0; i < 2; ++i )
+    {
+        double sdl = benchSDL( sizes[ i ][ 0 ], sizes[ i ][ 1 ], background, sprites );
+        double cpu = benchCPU( sizes[ i ][ 0 ], sizes[ i ][ 1 ], threads, background, sprites );
+        char size[ 32 ];
+        snprintf( size, sizeof( size ), "%dx%d", sizes[ i ][ 0 ], sizes[ i ][ 1 ] );
+        printf( "%-10s %10.3f %10.3f %9.2fx\n", size, sdl, cpu, sdl / cpu );
+    }
+
+    SDL_FreeSurface( sprites );
+    SDL_FreeSurface( background );
+    SDL_Quit();
+
+    return 0;
+}
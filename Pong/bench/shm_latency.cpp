@@ -0,0 +1,156 @@
+/*
+Round-trip latency of the shared-memory control interface.
+
+One thread plays the game side of a lockstep tick (publish state, wait for
+the answer) and another plays the bot, both going through a real named
+region. Prints the per-tick round trip distribution.
+*/
+
+#include "../pong_shm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+using namespace std;
+
+const int WARMUP_TICKS = 10000;
+const int TICKS = 200000;
+
+//Spins before giving up the core, keeps single-core hosts moving
+const int SPIN_LIMIT = 256;
+
+void backoff( int& spins )
+{
+    if( ++spins > SPIN_LIMIT )
+    {
+        this_thread::yield();
+        spins = 0;
+    }
+}
+
+//How the bot thread's start went
+enum BotStatus
+{
+    BOT_STARTING,
+    BOT_READY,
+    BOT_FAILED
+};
+
+void runBot( const char* name, atomic<int>* status )
+{
+    PongShm* shm = pong_shm_open( name );
+    if( shm == NULL )
+    {
+        status->store( BOT_FAILED );
+        return;
+    }
+    PongShmRegion* region = pong_shm_region( shm );
+    status->store( BOT_READY );
+
+    PongState state;
+    PongCommand command = PongCommand();
+    command.flags = PONG_CMD_P2;
+    int spins = 0;
+    while( pong_shm_get_flag( &region->game_attached ) )
+    {
+        if( !pong_shm_pop_state( region, &state ) )
+        {
+            backoff( spins );
+            continue;
+        }
+
+        command.tick = state.tick;
+        command.p2_dir = state.ball_y > state.p2_y ? 1 : -1;
+        while( !pong_shm_push_command( region, &command ) )
+        {
+            backoff( spins );
+        }
+    }
+
+    pong_shm_close( shm );
+}
+
+int main( int argc, char* args[] )
+{
+    int ticks = argc > 1 ? atoi( args[ 1 ] ) : TICKS;
+    if( ticks <= 0 )
+    {
+        printf( "Usage: %s [ticks > 0]\n", args[ 0 ] );
+        return 1;
+    }
+
+    PongShm* shm = pong_shm_create( "bench", PONG_SHM_LOCKSTEP );
+    if( shm == NULL )
+    {
+        return 1;
+    }
+    PongShmRegion* region = pong_shm_region( shm );
+
+    atomic<int> status( BOT_STARTING );
+    thread bot( runBot, "bench", &status );
+    while( status.load() == BOT_STARTING )
+    {
+        this_thread::yield();
+    }
+
+    //Nobody would ever answer the first tick
+    if( status.load() == BOT_FAILED )
+    {
+        printf( "Bot could not attach to the control region!\n" );
+        bot.join();
+        pong_shm_close( shm );
+        return 1;
+    }
+
+    vector<double> samples;
+    samples.reserve( ticks );
+
+    PongState state = PongState();
+    PongCommand command;
+    for( int tick = 0; tick < WARMUP_TICKS + ticks; ++tick )
+    {
+        state.tick = tick;
+        state.ball_y = tick % 600;
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        pong_shm_push_state( region, &state );
+        int spins = 0;
+        for( ;; )
+        {
+            if( pong_shm_pop_command( region, &command ) && command.tick == (uint32_t)tick )
+            {
+                break;
+            }
+            backoff( spins );
+        }
+        chrono::steady_clock::time_point end = chrono::steady_clock::now();
+
+        if( tick >= WARMUP_TICKS )
+        {
+            samples.push_back( chrono::duration<double, nano>( end - start ).count() );
+        }
+    }
+
+    pong_shm_close( shm );
+    bot.join();
+
+    sort( samples.begin(), samples.end() );
+    double total = 0;
+    for( size_t i = 0; i < samples.size(); ++i )
+    {
+        total += samples[ i ];
+    }
+
+    printf( "lockstep round trip over %d ticks (ns)\n", ticks );
+    printf( "  mean %.0f\n", total / samples.size() );
+    printf( "  min  %.0f\n", samples.front() );
+    printf( "  p50  %.0f\n", samples[ samples.size() / 2 ] );
+    printf( "  p99  %.0f\n", samples[ samples.size() * 99 / 100 ] );
+    printf( "  max  %.0f\n", samples.back() );
+
+    return 0;
+}
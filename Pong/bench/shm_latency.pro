@@ -0,0 +1,13 @@
+TEMPLATE = app
+CONFIG += console c++11 thread
+CONFIG -= app_bundle
+CONFIG -= qt
+
+SOURCES += \
+    shm_latency.cpp \
+    ../pong_shm.c
+
+HEADERS += \
+    ../pong_shm.h
+
+unix: LIBS += -lrt
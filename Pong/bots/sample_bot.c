@@ -0,0 +1,113 @@
+/*
+Sample bot for the shared-memory control interface.
+
+Start the game with "Pong --shm demo [--lockstep]" and then run
+"sample_bot demo". The bot drives the right paddle towards the ball and
+serves whenever the ball is at rest.
+*/
+
+#include "../pong_shm.h"
+
+#include <signal.h>
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#define bot_yield() Sleep( 0 )
+#else
+#include <sched.h>
+#define bot_yield() sched_yield()
+#endif
+
+//Must match the game
+#define PADDLE_HEIGHT 110
+#define BALL_HEIGHT 20
+
+//Mapped region, for the interrupt handler
+static PongShmRegion* gRegion = NULL;
+
+//Set by Ctrl-C or a termination request
+static volatile sig_atomic_t gStop = 0;
+
+//Detaches straight away, so a lockstep game stops waiting even before the
+//main loop notices
+static void onInterrupt( int sig )
+{
+    (void)sig;
+    gStop = 1;
+    if( gRegion != NULL )
+    {
+        pong_shm_set_flag( &gRegion->bot_attached, 0 );
+    }
+}
+
+int main( int argc, char* args[] )
+{
+    if( argc < 2 )
+    {
+        printf( "Usage: %s name\n", args[ 0 ] );
+        return 1;
+    }
+
+    PongShm* shm = pong_shm_open( args[ 1 ] );
+    if( shm == NULL )
+    {
+        printf( "Failed to open bot control region %s!\n", args[ 1 ] );
+        return 1;
+    }
+
+    PongShmRegion* region = pong_shm_region( shm );
+    gRegion = region;
+    signal( SIGINT, onInterrupt );
+    signal( SIGTERM, onInterrupt );
+    printf( "Attached in %s mode\n", region->mode == PONG_SHM_LOCKSTEP ? "lockstep" : "free-running" );
+
+    uint32_t answered = 0;
+    while( !gStop && pong_shm_get_flag( &region->game_attached ) )
+    {
+        //Lockstep has to answer every tick, free-running only cares about the newest
+        PongState state;
+        int got = region->mode == PONG_SHM_LOCKSTEP ? pong_shm_pop_state( region, &state ) : pong_shm_latest_state( region, &state );
+        if( !got )
+        {
+            bot_yield();
+            continue;
+        }
+
+        //Follow the ball with the centre of the paddle
+        int paddleCentre = state.p2_y + PADDLE_HEIGHT / 2;
+        int ballCentre = state.ball_y + BALL_HEIGHT / 2;
+
+        PongCommand command;
+        command.tick = state.tick;
+        command.p1_dir = 0;
+        command.p2_dir = 0;
+        command.flags = PONG_CMD_P2;
+        command.reserved = 0;
+
+        if( ballCentre < paddleCentre - 10 )
+        {
+            command.p2_dir = -1;
+        }
+        else if( ballCentre > paddleCentre + 10 )
+        {
+            command.p2_dir = 1;
+        }
+
+        if( state.ball_vx == 0 && state.ball_vy == 0 )
+        {
+            command.flags |= PONG_CMD_SERVE;
+        }
+
+        while( !gStop && !pong_shm_push_command( region, &command ) )
+        {
+            bot_yield();
+        }
+        answered++;
+    }
+
+    printf( "%s after %u ticks, %u states dropped\n", gStop ? "Interrupted" : "Game detached", answered, region->dropped_states );
+    pong_shm_close( shm );
+
+    return 0;
+}
@@ -0,0 +1,13 @@
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG -= qt
+
+SOURCES += \
+    sample_bot.c \
+    ../pong_shm.c
+
+HEADERS += \
+    ../pong_shm.h
+
+unix: LIBS += -lrt
@@ -0,0 +1,385 @@
+/*
+Asynchronous frame capture.
+*/
+
+#include "capture.h"
+
+#include <SDL_thread.h>
+using namespace std;
+
+IndexRing::IndexRing()
+{
+    //Initialize
+    mHead = 0;
+    mTail = 0;
+}
+
+void IndexRing::reset( int capacity )
+{
+    mSlots.assign( capacity, 0 );
+    mHead = 0;
+    mTail = 0;
+}
+
+bool IndexRing::push( int index )
+{
+    unsigned head = mHead.load( memory_order_relaxed );
+    if( head - mTail.load( memory_order_acquire ) == mSlots.size() )
+    {
+        return false;
+    }
+
+    mSlots[ head % mSlots.size() ] = index;
+    mHead.store( head + 1, memory_order_release );
+    return true;
+}
+
+bool IndexRing::pop( int& index )
+{
+    unsigned tail = mTail.load( memory_order_relaxed );
+    if( tail == mHead.load( memory_order_acquire ) )
+    {
+        return false;
+    }
+
+    index = mSlots[ tail % mSlots.size() ];
+    mTail.store( tail + 1, memory_order_release );
+    return true;
+}
+
+FrameCapture::FrameCapture()
+{
+    //Initialize
+    mFile = NULL;
+    mPipe = false;
+    mFormat = CAPTURE_Y4M;
+    mWidth = 0;
+    mHeight = 0;
+    mFps = 0;
+    mStartTicks = 0;
+    mNextSlot = 0;
+    mFilledCount = NULL;
+    mThread = NULL;
+    mStopping = false;
+    mCaptured = 0;
+    mSkipped = 0;
+    mDropped = 0;
+    mWritten = 0;
+    mOverheadTicks = 0;
+}
+
+FrameCapture::~FrameCapture()
+{
+    //Flush and close
+    stop();
+}
+
+bool FrameCapture::start( string path, CaptureFormat format, int width, int height, int fps, int poolSize )
+{
+    //Get rid of a previous capture
+    stop();
+
+    //Open the output
+    if( !path.empty() && path[ 0 ] == '|' )
+    {
+#ifdef _WIN32
+        mFile = _popen( path.c_str() + 1, "wb" );
+#else
+        mFile = popen( path.c_str() + 1, "w" );
+#endif
+        mPipe = true;
+    }
+    else
+    {
+        mFile = fopen( path.c_str(), "wb" );
+    }
+
+    if( mFile == NULL )
+    {
+        printf( "Unable to open capture output %s!\n", path.c_str() );
+        mPipe = false;
+        return false;
+    }
+
+    mFormat = format;
+    mWidth = width;
+    mHeight = height;
+    mFps = fps > 0 ? fps : 60;
+
+    //Y4M stream header
+    if( mFormat == CAPTURE_Y4M )
+    {
+        fprintf( mFile, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", mWidth, mHeight, mFps );
+        mYUV.resize( mWidth * mHeight + 2 * ( ( mWidth + 1 ) / 2 ) * ( ( mHeight + 1 ) / 2 ) );
+    }
+
+    //Allocate every buffer up front, all of them start free
+    mBuffers.assign( poolSize, vector<Uint8>( mWidth * mHeight * 4 ) );
+    mRepeats.assign( poolSize, 1 );
+    mFree.reset( poolSize );
+    mFilled.reset( poolSize );
+    for( int i = 0; i < poolSize; ++i )
+    {
+        mFree.push( i );
+    }
+
+    mCaptured = 0;
+    mSkipped = 0;
+    mDropped = 0;
+    mWritten = 0;
+    mOverheadTicks = 0;
+    mStopping = false;
+    mStartTicks = SDL_GetPerformanceCounter();
+    mNextSlot = 0;
+
+    mFilledCount = SDL_CreateSemaphore( 0 );
+    mThread = SDL_CreateThread( writerThread, "FrameCapture", this );
+    if( mFilledCount == NULL || mThread == NULL )
+    {
+        printf( "Unable to start capture writer! SDL Error: %s\n", SDL_GetError() );
+        stop();
+        return false;
+    }
+
+    return true;
+}
+
+void FrameCapture::captureFrame( SDL_Renderer* renderer )
+{
+    if( mThread == NULL )
+    {
+        return;
+    }
+
+    Uint64 startTicks = SDL_GetPerformanceCounter();
+    mCaptured++;
+
+    //Output slot this frame lands in, skip it if that slot already has one
+    Uint64 slot = ( startTicks - mStartTicks ) * mFps / SDL_GetPerformanceFrequency();
+    if( slot < mNextSlot )
+    {
+        mSkipped++;
+        mOverheadTicks += SDL_GetPerformanceCounter() - startTicks;
+        return;
+    }
+
+    //Take a free buffer or drop the frame, the next one then covers its slots
+    int index;
+    if( !mFree.pop( index ) )
+    {
+        mDropped++;
+    }
+    else
+    {
+        //Read back straight into the pooled buffer
+        if( SDL_RenderReadPixels( renderer, NULL, SDL_PIXELFORMAT_RGBA32, &mBuffers[ index ][ 0 ], mWidth * 4 ) != 0 )
+        {
+            printf( "Unable to read frame! SDL Error: %s\n", SDL_GetError() );
+            mFree.push( index );
+            mDropped++;
+        }
+        else
+        {
+            //Fill every slot since the last frame written, but no more than
+            //a second of them, a long stall is cut short instead of filling
+            //the output with copies
+            Uint64 repeats = slot - mNextSlot + 1;
+            if( repeats > (Uint64)mFps )
+            {
+                mSkipped += (Uint32)( repeats - mFps );
+                repeats = mFps;
+            }
+            mRepeats[ index ] = (int)repeats;
+            mNextSlot = slot + 1;
+
+            //Hand it to the writer
+            mFilled.push( index );
+            SDL_SemPost( mFilledCount );
+        }
+    }
+
+    mOverheadTicks += SDL_GetPerformanceCounter() - startTicks;
+}
+
+void FrameCapture::stop()
+{
+    //Let the writer drain what is queued
+    if( mThread != NULL )
+    {
+        mStopping = true;
+        SDL_SemPost( mFilledCount );
+        SDL_WaitThread( mThread, NULL );
+        mThread = NULL;
+
+        printf( "Capture: %u frames, %u written at %d fps, %u skipped, %u dropped, %.3f ms per frame on the render thread\n", mCaptured, mWritten.load(), mFps, mSkipped, mDropped, getAverageOverhead() );
+    }
+
+    if( mFilledCount != NULL )
+    {
+        SDL_DestroySemaphore( mFilledCount );
+        mFilledCount = NULL;
+    }
+
+    //Close the output
+    if( mFile != NULL )
+    {
+        if( mPipe )
+        {
+#ifdef _WIN32
+            _pclose( mFile );
+#else
+            pclose( mFile );
+#endif
+        }
+        else
+        {
+            fclose( mFile );
+        }
+        mFile = NULL;
+        mPipe = false;
+    }
+
+    mBuffers.clear();
+    mRepeats.clear();
+    mYUV.clear();
+}
+
+bool FrameCapture::isActive()
+{
+    return mThread != NULL;
+}
+
+Uint32 FrameCapture::getCaptured()
+{
+    return mCaptured;
+}
+
+Uint32 FrameCapture::getSkipped()
+{
+    return mSkipped;
+}
+
+Uint32 FrameCapture::getDropped()
+{
+    return mDropped;
+}
+
+Uint32 FrameCapture::getWritten()
+{
+    return mWritten.load();
+}
+
+double FrameCapture::getAverageOverhead()
+{
+    if( mCaptured == 0 )
+    {
+        return 0.0;
+    }
+    return mOverheadTicks * 1000.0 / SDL_GetPerformanceFrequency() / mCaptured;
+}
+
+int FrameCapture::writerThread( void* data )
+{
+    FrameCapture* capture = (FrameCapture*)data;
+
+    for( ;; )
+    {
+        SDL_SemWait( capture->mFilledCount );
+
+        int index;
+        if( !capture->mFilled.pop( index ) )
+        {
+            //Woken with nothing queued only happens when stopping
+            if( capture->mStopping )
+            {
+                break;
+            }
+            continue;
+        }
+
+        int repeats = capture->mRepeats[ index ];
+        if( capture->writeFrame( &capture->mBuffers[ index ][ 0 ], repeats ) )
+        {
+            capture->mWritten += repeats;
+        }
+
+        //Give the buffer back to the render thread
+        capture->mFree.push( index );
+    }
+
+    return 0;
+}
+
+bool FrameCapture::writeFrame( const Uint8* pixels, int repeats )
+{
+    if( mFormat == CAPTURE_RGBA )
+    {
+        bool success = true;
+        for( int i = 0; i < repeats && success; ++i )
+        {
+            success = fwrite( pixels, mWidth * 4, mHeight, mFile ) == (size_t)mHeight;
+        }
+        return success;
+    }
+
+    //BT.601 studio range, chroma averaged over each 2x2 block
+    int chromaWidth = ( mWidth + 1 ) / 2;
+    int chromaHeight = ( mHeight + 1 ) / 2;
+    Uint8* planeY = &mYUV[ 0 ];
+    Uint8* planeU = planeY + mWidth * mHeight;
+    Uint8* planeV = planeU + chromaWidth * chromaHeight;
+
+    for( int y = 0; y < mHeight; ++y )
+    {
+        const Uint8* row = pixels + y * mWidth * 4;
+        for( int x = 0; x < mWidth; ++x )
+        {
+            int r = row[ x * 4 ], g = row[ x * 4 + 1 ], b = row[ x * 4 + 2 ];
+            planeY[ y * mWidth + x ] = (Uint8)( ( ( 66 * r + 129 * g + 25 * b + 128 ) >> 8 ) + 16 );
+        }
+    }
+
+    for( int cy = 0; cy < chromaHeight; ++cy )
+    {
+        for( int cx = 0; cx < chromaWidth; ++cx )
+        {
+            int r = 0, g = 0, b = 0, count = 0;
+            for( int dy = 0; dy < 2; ++dy )
+            {
+                int y = cy * 2 + dy;
+                if( y >= mHeight )
+                {
+                    continue;
+                }
+                for( int dx = 0; dx < 2; ++dx )
+                {
+                    int x = cx * 2 + dx;
+                    if( x >= mWidth )
+                    {
+                        continue;
+                    }
+                    const Uint8* p = pixels + ( y * mWidth + x ) * 4;
+                    r += p[ 0 ];
+                    g += p[ 1 ];
+                    b += p[ 2 ];
+                    count++;
+                }
+            }
+            r /= count;
+            g /= count;
+            b /= count;
+
+            planeU[ cy * chromaWidth + cx ] = (Uint8)( ( -38 * r - 74 * g + 112 * b + 32896 ) >> 8 );
+            planeV[ cy * chromaWidth + cx ] = (Uint8)( ( 112 * r - 94 * g - 18 * b + 32896 ) >> 8 );
+        }
+    }
+
+    //Convert once, write once per slot
+    bool success = true;
+    for( int i = 0; i < repeats && success; ++i )
+    {
+        fputs( "FRAME\n", mFile );
+        success = fwrite( &mYUV[ 0 ], 1, mYUV.size(), mFile ) == mYUV.size();
+    }
+    return success;
+}
@@ -0,0 +1,142 @@
+/*
+Asynchronous frame capture.
+
+Each rendered frame is read back into one of a fixed pool of buffers and
+handed to a writer thread that streams it as Y4M or raw RGBA to a file or a
+pipe. When every buffer is still queued the frame is dropped and counted,
+the render thread never waits on the writer.
+
+Output is paced to the frame rate given to start() by wall clock: frames
+rendered faster than that are skipped, and a frame that covers several
+output slots (a slow frame or a dropped one before it) is written once per
+slot, so playback runs at the speed the match was played. Repeats stop at one
+second's worth; the slots of a longer stall are skipped.
+*/
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <SDL.h>
+#include <stdio.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+//Capture output formats
+enum CaptureFormat
+{
+    CAPTURE_Y4M,
+    CAPTURE_RGBA
+};
+
+//Single-producer single-consumer ring of buffer indices
+class IndexRing
+{
+    public:
+        //Initializes variables
+        IndexRing();
+
+        //Sets the capacity and empties the ring
+        void reset( int capacity );
+
+        //Adds an index, returns false if the ring is full
+        bool push( int index );
+
+        //Takes the oldest index, returns false if the ring is empty
+        bool pop( int& index );
+
+    private:
+        std::vector<int> mSlots;
+        std::atomic<unsigned> mHead;
+        std::atomic<unsigned> mTail;
+};
+
+//Frame capture wrapper class
+class FrameCapture
+{
+    public:
+        //Number of preallocated frame buffers
+        static const int DEFAULT_POOL_SIZE = 8;
+
+        //Initializes variables
+        FrameCapture();
+
+        //Stops capturing
+        ~FrameCapture();
+
+        //Opens the output and starts the writer thread. A path starting
+        //with '|' is run as a command and fed through a pipe
+        bool start( std::string path, CaptureFormat format, int width, int height, int fps, int poolSize = DEFAULT_POOL_SIZE );
+
+        //Copies the current render target if an output slot has come up,
+        //call before SDL_RenderPresent
+        void captureFrame( SDL_Renderer* renderer );
+
+        //Flushes queued frames, stops the writer and closes the output
+        void stop();
+
+        //Checks if capture is running
+        bool isActive();
+
+        //Frame counters
+        Uint32 getCaptured();
+        Uint32 getSkipped();
+        Uint32 getDropped();
+        Uint32 getWritten();
+
+        //Average time captureFrame spent on the render thread in ms
+        double getAverageOverhead();
+
+    private:
+        //Writer thread entry point
+        static int writerThread( void* data );
+
+        //Writes one frame in the output format, repeated for each slot it covers
+        bool writeFrame( const Uint8* pixels, int repeats );
+
+        //Output stream
+        FILE* mFile;
+        bool mPipe;
+
+        //Frame layout
+        CaptureFormat mFormat;
+        int mWidth;
+        int mHeight;
+
+        //Output pacing, slots are 1/fps s from the start of the capture
+        int mFps;
+        Uint64 mStartTicks;
+        Uint64 mNextSlot;
+
+        //Slots each queued buffer covers, set before it is handed over
+        std::vector<int> mRepeats;
+
+        //Preallocated RGBA frames
+        std::vector< std::vector<Uint8> > mBuffers;
+
+        //Planar YUV scratch for the writer thread
+        std::vector<Uint8> mYUV;
+
+        //Buffers the render thread may fill
+        IndexRing mFree;
+
+        //Buffers waiting for the writer thread
+        IndexRing mFilled;
+
+        //Counts frames in mFilled so the writer can sleep
+        SDL_sem* mFilledCount;
+
+        SDL_Thread* mThread;
+        std::atomic<bool> mStopping;
+
+        //Counters
+        Uint32 mCaptured;
+        Uint32 mSkipped;
+        Uint32 mDropped;
+        std::atomic<Uint32> mWritten;
+
+        //Render thread cost
+        Uint64 mOverheadTicks;
+};
+
+#endif
@@ -0,0 +1,676 @@
+/*
+Crash-recovery checkpoints for matches in progress.
+*/
+
+#include "checkpoint.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+//File and record identification
+static const uint32_t JOURNAL_MAGIC = 0x4E524A50; /* "PJRN" */
+static const uint32_t RECORD_MAGIC = 0x43524A50; /* "PJRC" */
+static const uint32_t JOURNAL_VERSION = 1;
+
+//Records start after the header's own cache line
+static const uint64_t HEADER_SPACE = 64;
+
+//Start of each journal file
+struct JournalHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t matchSize;
+    uint32_t matchCount;
+    uint64_t generation;
+    uint64_t checksum;
+};
+
+//Start of each record, followed by the match
+struct JournalRecord
+{
+    uint32_t magic;
+    uint32_t index;
+    uint64_t generation;
+    uint64_t checksum;
+};
+
+//Four independent multiply-xor lanes over 8 byte words, so the checksum
+//runs near memory speed
+static uint64_t checksum( const uint8_t* data, size_t size, uint64_t seed )
+{
+    const uint64_t PRIME = 0x9E3779B97F4A7C15ull;
+    uint64_t lanes[ 4 ] = { seed, seed ^ 0x243F6A8885A308D3ull, seed ^ 0x13198A2E03707344ull, seed ^ 0xA4093822299F31D0ull };
+
+    size_t i = 0;
+    for( ; i + 32 <= size; i += 32 )
+    {
+        for( int lane = 0; lane < 4; ++lane )
+        {
+            uint64_t word;
+            memcpy( &word, data + i + lane * 8, 8 );
+            lanes[ lane ] = ( lanes[ lane ] ^ word ) * PRIME;
+            lanes[ lane ] ^= lanes[ lane ] >> 29;
+        }
+    }
+
+    uint64_t hash = size;
+    for( int lane = 0; lane < 4; ++lane )
+    {
+        hash = ( hash ^ lanes[ lane ] ) * PRIME;
+    }
+
+    //Leftover bytes
+    for( ; i < size; ++i )
+    {
+        hash = ( hash ^ data[ i ] ) * PRIME;
+    }
+
+    return hash ^ ( hash >> 32 );
+}
+
+//Checksum of a record's index, generation and match
+static uint64_t recordChecksum( const JournalRecord& record, const uint8_t* match, uint32_t matchSize )
+{
+    uint64_t seed = ( (uint64_t)record.index << 32 ) ^ record.generation;
+    return checksum( match, matchSize, seed );
+}
+
+static uint64_t headerChecksum( const JournalHeader& header )
+{
+    return checksum( (const uint8_t*)&header, offsetof( JournalHeader, checksum ), JOURNAL_MAGIC );
+}
+
+//Maps a file of the given size, creating or growing it as needed
+static bool mapFile( const string& path, uint64_t size, JournalFile& file )
+{
+    file.data = NULL;
+    file.size = size;
+
+#ifdef _WIN32
+    file.file = CreateFileA( path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL );
+    if( file.file == INVALID_HANDLE_VALUE )
+    {
+        printf( "Unable to open journal %s! Error: %lu\n", path.c_str(), GetLastError() );
+        return false;
+    }
+
+    file.mapping = CreateFileMappingA( file.file, NULL, PAGE_READWRITE, (DWORD)( size >> 32 ), (DWORD)size, NULL );
+    if( file.mapping == NULL )
+    {
+        printf( "Unable to map journal %s! Error: %lu\n", path.c_str(), GetLastError() );
+        CloseHandle( file.file );
+        return false;
+    }
+
+    file.data = (uint8_t*)MapViewOfFile( file.mapping, FILE_MAP_ALL_ACCESS, 0, 0, size );
+    if( file.data == NULL )
+    {
+        printf( "Unable to map journal %s! Error: %lu\n", path.c_str(), GetLastError() );
+        CloseHandle( file.mapping );
+        CloseHandle( file.file );
+        return false;
+    }
+#else
+    file.fd = ::open( path.c_str(), O_RDWR | O_CREAT, 0644 );
+    if( file.fd < 0 )
+    {
+        perror( "Unable to open journal" );
+        return false;
+    }
+
+    //Only ever grow, a shorter file would cut records off
+    struct stat info;
+    if( fstat( file.fd, &info ) != 0 || ( (uint64_t)info.st_size < size && ftruncate( file.fd, size ) != 0 ) )
+    {
+        perror( "Unable to size journal" );
+        ::close( file.fd );
+        return false;
+    }
+
+    void* data = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, file.fd, 0 );
+    if( data == MAP_FAILED )
+    {
+        perror( "Unable to map journal" );
+        ::close( file.fd );
+        return false;
+    }
+    file.data = (uint8_t*)data;
+#endif
+
+    return true;
+}
+
+//Writes a range of the file back to disk, waiting for it if wait is set
+static void flushFile( JournalFile& file, uint64_t offset, uint64_t size, bool wait )
+{
+    if( size == 0 )
+    {
+        return;
+    }
+
+#ifdef _WIN32
+    FlushViewOfFile( file.data + offset, (SIZE_T)size );
+    if( wait )
+    {
+        FlushFileBuffers( file.file );
+    }
+#else
+    //msync wants a page aligned start
+    uint64_t page = (uint64_t)sysconf( _SC_PAGESIZE );
+    uint64_t start = offset / page * page;
+    msync( file.data + start, offset + size - start, wait ? MS_SYNC : MS_ASYNC );
+#endif
+}
+
+static void unmapFile( JournalFile& file )
+{
+    if( file.data == NULL )
+    {
+        return;
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile( file.data );
+    CloseHandle( file.mapping );
+    CloseHandle( file.file );
+#else
+    munmap( file.data, file.size );
+    ::close( file.fd );
+#endif
+
+    file.data = NULL;
+}
+
+MatchJournal::MatchJournal()
+{
+    //Initialize
+    mFiles[ 0 ].data = NULL;
+    mFiles[ 1 ].data = NULL;
+    mActive = 0;
+    mGeneration = 0;
+    mEnd = 0;
+    mPublishedEnd = 0;
+    mMatchSize = 0;
+    mMatchCount = 0;
+    mRecordSize = 0;
+    mCompareSize = 0;
+    mSnapshotFile = 0;
+    mSnapshotGeneration = 0;
+    mSnapshotFrom = 0;
+    mSnapshotEnd = 0;
+    mSnapshotPending = false;
+    mThread = NULL;
+    mRequest = NULL;
+    mDone = NULL;
+    mStopping = false;
+}
+
+MatchJournal::~MatchJournal()
+{
+    //Flush and unmap
+    close();
+}
+
+bool MatchJournal::open( string path, uint32_t matchSize, uint32_t matchCount, uint64_t capacity, uint32_t compareSize )
+{
+    //Get rid of a previous journal
+    close();
+
+    if( matchSize == 0 || matchCount == 0 )
+    {
+        printf( "Journal needs at least one match!\n" );
+        return false;
+    }
+
+    mMatchSize = matchSize;
+    mMatchCount = matchCount;
+    mCompareSize = compareSize == 0 || compareSize > matchSize ? matchSize : compareSize;
+
+    //Records stay 8 byte aligned
+    mRecordSize = ( sizeof( JournalRecord ) + matchSize + 7 ) / 8 * 8;
+
+    //Each file has to hold a full snapshot with room to append after it
+    uint64_t snapshotSize = HEADER_SPACE + (uint64_t)mRecordSize * matchCount;
+    if( capacity < snapshotSize * 4 )
+    {
+        capacity = snapshotSize * 4;
+    }
+
+    for( int i = 0; i < 2; ++i )
+    {
+        char suffix[ 8 ];
+        snprintf( suffix, sizeof( suffix ), ".%d", i );
+        if( !mapFile( path + suffix, capacity, mFiles[ i ] ) )
+        {
+            close();
+            return false;
+        }
+    }
+
+    //Resume from the newer complete file
+    uint64_t generations[ 2 ] = { readHeader( mFiles[ 0 ] ), readHeader( mFiles[ 1 ] ) };
+    mActive = generations[ 1 ] > generations[ 0 ] ? 1 : 0;
+    mGeneration = generations[ mActive ];
+
+    mShadow.assign( (size_t)mMatchSize * mMatchCount, 0 );
+    mPresent.assign( mMatchCount, false );
+    if( mGeneration != 0 )
+    {
+        replay( mFiles[ mActive ], mGeneration, mFiles[ mActive ].size, &mShadow[ 0 ], mPresent );
+    }
+
+    //Start a clean generation so nothing left past a torn record can come
+    //back. A newer file whose header never reached the disk still holds
+    //records of its generation, so the new one has to be above every
+    //record in either file, not just above the header
+    uint64_t generation = mGeneration;
+    for( int i = 0; i < 2; ++i )
+    {
+        uint64_t newest = newestRecord( mFiles[ i ] );
+        generation = newest > generation ? newest : generation;
+    }
+    generation++;
+
+    //Nothing is running yet, so this one is written in place
+    int next = 1 - mActive;
+    mEnd = writeSnapshot( mFiles[ next ], generation, &mShadow[ 0 ], mPresent );
+    writeHeader( mFiles[ next ], generation, true );
+    mActive = next;
+    mGeneration = generation;
+
+    //Later snapshots are built in the background
+    mStopping = false;
+    mRequest = SDL_CreateSemaphore( 0 );
+    mDone = SDL_CreateSemaphore( 0 );
+    if( mRequest != NULL && mDone != NULL )
+    {
+        mThread = SDL_CreateThread( writerThread, "MatchJournal", this );
+    }
+    if( mThread == NULL )
+    {
+        printf( "Unable to start journal writer! SDL Error: %s\n", SDL_GetError() );
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+uint32_t MatchJournal::restore( void* matches, vector<bool>* restored )
+{
+    uint32_t count = 0;
+    uint8_t* out = (uint8_t*)matches;
+    for( uint32_t i = 0; i < mMatchCount; ++i )
+    {
+        if( mPresent[ i ] )
+        {
+            memcpy( out + (size_t)i * mMatchSize, &mShadow[ (size_t)i * mMatchSize ], mMatchSize );
+            count++;
+        }
+    }
+
+    if( restored != NULL )
+    {
+        *restored = mPresent;
+    }
+
+    return count;
+}
+
+uint32_t MatchJournal::checkpoint( const void* matches, uint32_t part, uint32_t parts )
+{
+    if( !isOpen() || parts == 0 || part >= parts )
+    {
+        return 0;
+    }
+
+    const uint8_t* in = (const uint8_t*)matches;
+    uint32_t first = (uint32_t)( (uint64_t)mMatchCount * part / parts );
+    uint32_t last = (uint32_t)( (uint64_t)mMatchCount * ( part + 1 ) / parts );
+
+    //Move to the new file as soon as the writer has it ready
+    finishSnapshot( false );
+
+    uint32_t written = 0;
+    if( !appendChanged( in, first, last, written ) )
+    {
+        //Filled up before the snapshot was done, only then the tick waits
+        if( !mSnapshotPending )
+        {
+            startSnapshot();
+        }
+        finishSnapshot( true );
+        appendChanged( in, first, last, written );
+    }
+
+    //Start the next snapshot long before this file fills up
+    if( !mSnapshotPending && mEnd > mFiles[ mActive ].size / 2 )
+    {
+        startSnapshot();
+    }
+
+    return written;
+}
+
+void MatchJournal::close()
+{
+    //Take the snapshot in flight, then stop the writer
+    if( mThread != NULL )
+    {
+        finishSnapshot( true );
+        mStopping = true;
+        SDL_SemPost( mRequest );
+        SDL_WaitThread( mThread, NULL );
+        mThread = NULL;
+    }
+
+    if( mRequest != NULL )
+    {
+        SDL_DestroySemaphore( mRequest );
+        mRequest = NULL;
+    }
+
+    if( mDone != NULL )
+    {
+        SDL_DestroySemaphore( mDone );
+        mDone = NULL;
+    }
+
+    if( mFiles[ mActive ].data != NULL )
+    {
+        flushFile( mFiles[ mActive ], 0, mEnd, true );
+    }
+
+    unmapFile( mFiles[ 0 ] );
+    unmapFile( mFiles[ 1 ] );
+    mShadow.clear();
+    mPresent.clear();
+    mSnapshot.clear();
+    mSnapshotPresent.clear();
+    mSnapshotPending = false;
+    mEnd = 0;
+    mGeneration = 0;
+}
+
+bool MatchJournal::isOpen()
+{
+    return mFiles[ mActive ].data != NULL;
+}
+
+uint64_t MatchJournal::getBytesUsed()
+{
+    return mEnd;
+}
+
+uint64_t MatchJournal::getGeneration()
+{
+    return mGeneration;
+}
+
+uint64_t MatchJournal::readHeader( const JournalFile& file )
+{
+    JournalHeader header;
+    memcpy( &header, file.data, sizeof( header ) );
+
+    if( header.magic != JOURNAL_MAGIC || header.version != JOURNAL_VERSION || header.checksum != headerChecksum( header ) )
+    {
+        return 0;
+    }
+
+    if( header.matchSize != mMatchSize || header.matchCount != mMatchCount )
+    {
+        printf( "Journal was written for %u matches of %u bytes, ignoring it\n", header.matchCount, header.matchSize );
+        return 0;
+    }
+
+    return header.generation;
+}
+
+uint64_t MatchJournal::newestRecord( const JournalFile& file )
+{
+    //Records only ever start on the record grid, torn ones don't count
+    uint64_t newest = 0;
+    for( uint64_t offset = HEADER_SPACE; offset + mRecordSize <= file.size; offset += mRecordSize )
+    {
+        JournalRecord record;
+        memcpy( &record, file.data + offset, sizeof( record ) );
+        const uint8_t* match = file.data + offset + sizeof( record );
+
+        if( record.magic == RECORD_MAGIC && record.generation > newest && record.index < mMatchCount && record.checksum == recordChecksum( record, match, mMatchSize ) )
+        {
+            newest = record.generation;
+        }
+    }
+
+    return newest;
+}
+
+uint64_t MatchJournal::replay( const JournalFile& file, uint64_t generation, uint64_t limit, uint8_t* shadow, vector<bool>& present )
+{
+    //Stop at the first record that is torn or from an older generation
+    uint64_t offset = HEADER_SPACE;
+    while( offset + mRecordSize <= limit )
+    {
+        JournalRecord record;
+        memcpy( &record, file.data + offset, sizeof( record ) );
+        const uint8_t* match = file.data + offset + sizeof( record );
+
+        if( record.magic != RECORD_MAGIC || record.generation != generation || record.index >= mMatchCount || record.checksum != recordChecksum( record, match, mMatchSize ) )
+        {
+            break;
+        }
+
+        memcpy( shadow + (size_t)record.index * mMatchSize, match, mMatchSize );
+        present[ record.index ] = true;
+        offset += mRecordSize;
+    }
+
+    return offset;
+}
+
+bool MatchJournal::appendChanged( const uint8_t* matches, uint32_t first, uint32_t last, uint32_t& written )
+{
+    JournalFile& file = mFiles[ mActive ];
+    uint64_t batchStart = mEnd;
+    bool fits = true;
+
+    for( uint32_t i = first; i < last; ++i )
+    {
+        //Bytes past mCompareSize ride along but never make a match dirty
+        const uint8_t* match = matches + (size_t)i * mMatchSize;
+        uint8_t* shadow = &mShadow[ (size_t)i * mMatchSize ];
+        if( mPresent[ i ] && memcmp( match, shadow, mCompareSize ) == 0 )
+        {
+            continue;
+        }
+
+        if( mEnd + mRecordSize > file.size )
+        {
+            fits = false;
+            break;
+        }
+
+        appendRecord( file, mEnd, mGeneration, i, match );
+        memcpy( shadow, match, mMatchSize );
+        mPresent[ i ] = true;
+        written++;
+    }
+
+    //One write-back request per batch
+    flushFile( file, batchStart, mEnd - batchStart, false );
+    mPublishedEnd.store( mEnd );
+
+    return fits;
+}
+
+void MatchJournal::startSnapshot()
+{
+    //Everything before mEnd is already written and never changes, so the
+    //writer rebuilds the state from the file while the game keeps appending
+    //past it. Copying mShadow here would put a copy of every match on the
+    //tick
+    mSnapshotFile = 1 - mActive;
+    mSnapshotGeneration = mGeneration + 1;
+    mSnapshotFrom = mEnd;
+    mSnapshotPending = true;
+    mPublishedEnd.store( mEnd );
+
+    SDL_SemPost( mRequest );
+}
+
+void MatchJournal::copyRecords( const JournalFile& from, uint64_t start, uint64_t end, JournalFile& to, uint64_t& offset, uint64_t generation )
+{
+    //A snapshot takes at most a quarter of a file and the records to copy
+    //came after the active file was half full, so they always fit
+    for( uint64_t at = start; at < end; at += mRecordSize )
+    {
+        JournalRecord record;
+        memcpy( &record, from.data + at, sizeof( record ) );
+        appendRecord( to, offset, generation, record.index, from.data + at + sizeof( record ) );
+    }
+}
+
+bool MatchJournal::finishSnapshot( bool wait )
+{
+    if( !mSnapshotPending )
+    {
+        return false;
+    }
+
+    if( wait )
+    {
+        SDL_SemWait( mDone );
+    }
+    else if( SDL_SemTryWait( mDone ) != 0 )
+    {
+        return false;
+    }
+    mSnapshotPending = false;
+
+    //Copy what was appended after the writer caught up, usually nothing or
+    //one batch, so the new file holds everything the old one does
+    JournalFile& target = mFiles[ mSnapshotFile ];
+    uint64_t end = mSnapshotEnd;
+    copyRecords( mFiles[ mActive ], mSnapshotFrom, mEnd, target, end, mSnapshotGeneration );
+    flushFile( target, mSnapshotEnd, end - mSnapshotEnd, false );
+
+    //The snapshot is on disk, the header makes the new file the one to
+    //resume from. Its write-back can finish in its own time
+    writeHeader( target, mSnapshotGeneration, false );
+    mActive = mSnapshotFile;
+    mGeneration = mSnapshotGeneration;
+    mEnd = end;
+    mPublishedEnd.store( mEnd );
+
+    return true;
+}
+
+int MatchJournal::writerThread( void* data )
+{
+    MatchJournal* journal = (MatchJournal*)data;
+
+    //A snapshot has half a file of checkpoints to finish in, a tick has
+    //one frame, so never take the core from the game
+    SDL_SetThreadPriority( SDL_THREAD_PRIORITY_LOW );
+
+    for( ;; )
+    {
+        SDL_SemWait( journal->mRequest );
+        if( journal->mStopping )
+        {
+            break;
+        }
+
+        //The file being appended to must have its header on disk before
+        //the other one is wiped, or a crash here would leave neither
+        JournalFile& target = journal->mFiles[ journal->mSnapshotFile ];
+        JournalFile& source = journal->mFiles[ 1 - journal->mSnapshotFile ];
+        flushFile( source, 0, HEADER_SPACE, true );
+
+        //The source starts with a full snapshot, so replaying it gives
+        //every match as of mSnapshotFrom
+        journal->mSnapshot.resize( (size_t)journal->mMatchSize * journal->mMatchCount );
+        journal->mSnapshotPresent.assign( journal->mMatchCount, false );
+        journal->replay( source, journal->mSnapshotGeneration - 1, journal->mSnapshotFrom, &journal->mSnapshot[ 0 ], journal->mSnapshotPresent );
+
+        uint64_t snapshotEnd = journal->writeSnapshot( target, journal->mSnapshotGeneration, &journal->mSnapshot[ 0 ], journal->mSnapshotPresent );
+
+        //Carry over what the game appended meanwhile until it has caught
+        //up, each pass has less to copy than the one before
+        uint64_t from = journal->mSnapshotFrom;
+        uint64_t end = snapshotEnd;
+        uint64_t published;
+        while( ( published = journal->mPublishedEnd.load() ) != from )
+        {
+            journal->copyRecords( source, from, published, target, end, journal->mSnapshotGeneration );
+            from = published;
+        }
+        flushFile( target, snapshotEnd, end - snapshotEnd, false );
+
+        journal->mSnapshotFrom = from;
+        journal->mSnapshotEnd = end;
+        SDL_SemPost( journal->mDone );
+    }
+
+    return 0;
+}
+
+uint64_t MatchJournal::writeSnapshot( JournalFile& file, uint64_t generation, const uint8_t* source, const vector<bool>& present )
+{
+    //Invalidate the header first so a half written snapshot is never picked
+    memset( file.data, 0, HEADER_SPACE );
+    flushFile( file, 0, HEADER_SPACE, true );
+
+    //Every match ever written goes in, a fresh journal stays empty
+    uint64_t end = HEADER_SPACE;
+    for( uint32_t i = 0; i < mMatchCount; ++i )
+    {
+        if( present[ i ] )
+        {
+            appendRecord( file, end, generation, i, source + (size_t)i * mMatchSize );
+        }
+    }
+    flushFile( file, HEADER_SPACE, end - HEADER_SPACE, true );
+
+    return end;
+}
+
+void MatchJournal::writeHeader( JournalFile& file, uint64_t generation, bool wait )
+{
+    JournalHeader header;
+    header.magic = JOURNAL_MAGIC;
+    header.version = JOURNAL_VERSION;
+    header.matchSize = mMatchSize;
+    header.matchCount = mMatchCount;
+    header.generation = generation;
+    header.checksum = headerChecksum( header );
+    memcpy( file.data, &header, sizeof( header ) );
+    flushFile( file, 0, HEADER_SPACE, wait );
+}
+
+void MatchJournal::appendRecord( JournalFile& file, uint64_t& offset, uint64_t generation, uint32_t index, const uint8_t* match )
+{
+    JournalRecord record;
+    record.magic = RECORD_MAGIC;
+    record.index = index;
+    record.generation = generation;
+    record.checksum = recordChecksum( record, match, mMatchSize );
+
+    uint8_t* out = file.data + offset;
+    memcpy( out + sizeof( record ), match, mMatchSize );
+    memcpy( out, &record, sizeof( record ) );
+    offset += mRecordSize;
+}
@@ -0,0 +1,166 @@
+/*
+Crash-recovery checkpoints for matches in progress.
+
+Matches are fixed-size, trivially copyable blobs identified by their index.
+Each checkpoint compares matches with the copy last written and appends
+only the ones that changed, as one batch of checksummed records, to a
+memory-mapped journal. Only a leading part of each match takes part in the
+comparison, so a counter that moves every frame doesn't make every match
+dirty, and a checkpoint can cover a slice of the matches so the work is
+spread over several ticks. Two journal files take turns: once the active one
+is half full a writer thread replays it into a full snapshot in the other
+file and copies over what checkpoints append meanwhile. The next checkpoint
+after it is done copies the last few records itself, marks the other file
+newer and switches over. A crash at any point leaves one complete
+journal to resume from. Only a file filling up before its snapshot is done,
+or a restore, makes the caller wait for a snapshot.
+*/
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <SDL.h>
+#include <SDL_thread.h>
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+//Memory-mapped file
+struct JournalFile
+{
+    uint8_t* data;
+    uint64_t size;
+
+#ifdef _WIN32
+    void* file;
+    void* mapping;
+#else
+    int fd;
+#endif
+};
+
+//Match checkpoint journal
+class MatchJournal
+{
+    public:
+        //Default size of each journal file
+        static const uint64_t DEFAULT_CAPACITY = 64ull << 20;
+
+        //Initializes variables
+        MatchJournal();
+
+        //Closes the journal
+        ~MatchJournal();
+
+        //Opens path.0 and path.1, creating them if needed, and replays the
+        //newer one. The replayed state is snapshotted into a fresh
+        //generation before returning, then the writer thread starts.
+        //Only the first compareSize bytes of a match decide whether it
+        //changed, 0 compares all of it. The rest is saved along with them
+        bool open( std::string path, uint32_t matchSize, uint32_t matchCount, uint64_t capacity = DEFAULT_CAPACITY, uint32_t compareSize = 0 );
+
+        //Copies every match the journal had into matches, returns how many.
+        //restored, if given, is set per match
+        uint32_t restore( void* matches, std::vector<bool>* restored = NULL );
+
+        //Appends the matches that changed since the last checkpoint,
+        //returns how many were written. With parts above 1 only slice part
+        //of that many equal slices of the matches is compared, so calling
+        //it once per tick with part = tick % parts covers every match each
+        //parts ticks. Never syncs to disk itself
+        uint32_t checkpoint( const void* matches, uint32_t part = 0, uint32_t parts = 1 );
+
+        //Finishes the snapshot in flight, flushes and unmaps the journal
+        void close();
+
+        //Checks if the journal is open
+        bool isOpen();
+
+        //Bytes of the active file in use
+        uint64_t getBytesUsed();
+
+        //Generation of the active file, grows with every snapshot
+        uint64_t getGeneration();
+
+    private:
+        //Checks a file's header, returns its generation or 0 if invalid
+        uint64_t readHeader( const JournalFile& file );
+
+        //Newest generation of any intact record anywhere in a file
+        uint64_t newestRecord( const JournalFile& file );
+
+        //Replays a file's records of one generation, up to limit, into
+        //shadow and present. Stops at the first torn or older record and
+        //returns where
+        uint64_t replay( const JournalFile& file, uint64_t generation, uint64_t limit, uint8_t* shadow, std::vector<bool>& present );
+
+        //Appends the matches in [first, last) that differ from mShadow,
+        //returns false if the active file ran out of room first
+        bool appendChanged( const uint8_t* matches, uint32_t first, uint32_t last, uint32_t& written );
+
+        //Asks the writer thread for a snapshot of the active file as it is now
+        void startSnapshot();
+
+        //Appends the records in [start, end) of one file to another,
+        //restamped with the other's generation
+        void copyRecords( const JournalFile& from, uint64_t start, uint64_t end, JournalFile& to, uint64_t& offset, uint64_t generation );
+
+        //Switches to the snapshot the writer finished, waiting for it if
+        //wait is set. Returns false if there was none to switch to
+        bool finishSnapshot( bool wait );
+
+        //Writer thread entry point
+        static int writerThread( void* data );
+
+        //Writes the present matches of source as a snapshot after the
+        //header and syncs it, returns where the records end
+        uint64_t writeSnapshot( JournalFile& file, uint64_t generation, const uint8_t* source, const std::vector<bool>& present );
+
+        //Writes the header that makes a file's snapshot the one to resume from
+        void writeHeader( JournalFile& file, uint64_t generation, bool wait );
+
+        //Appends one record at offset
+        void appendRecord( JournalFile& file, uint64_t& offset, uint64_t generation, uint32_t index, const uint8_t* match );
+
+        //Journal files, mFiles[ mActive ] is the one being appended to
+        JournalFile mFiles[ 2 ];
+        int mActive;
+        uint64_t mGeneration;
+
+        //Write position in the active file, and as published to the writer
+        //thread after each batch
+        uint64_t mEnd;
+        std::atomic<uint64_t> mPublishedEnd;
+
+        //Match layout
+        uint32_t mMatchSize;
+        uint32_t mMatchCount;
+        uint32_t mRecordSize;
+        uint32_t mCompareSize;
+
+        //Every match as last written, and whether it was written at all
+        std::vector<uint8_t> mShadow;
+        std::vector<bool> mPresent;
+
+        //Writer thread scratch the active file is replayed into
+        std::vector<uint8_t> mSnapshot;
+        std::vector<bool> mSnapshotPresent;
+
+        //Snapshot in flight, untouched by the game while mSnapshotPending
+        //is set. mSnapshotFrom is how far into the active file the writer
+        //has copied, mSnapshotEnd where it got to in the new file
+        int mSnapshotFile;
+        uint64_t mSnapshotGeneration;
+        uint64_t mSnapshotFrom;
+        uint64_t mSnapshotEnd;
+        bool mSnapshotPending;
+
+        //Writer thread, woken by mRequest and answering on mDone
+        SDL_Thread* mThread;
+        SDL_sem* mRequest;
+        SDL_sem* mDone;
+        std::atomic<bool> mStopping;
+};
+
+#endif
@@ -0,0 +1,440 @@
+/*
+Scripted frame-time harness.
+*/
+
+#include "harness.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+using namespace std;
+
+//Histogram of frame times in the report
+const double HISTOGRAM_BUCKET_MS = 0.5;
+const int HISTOGRAM_BUCKETS = 64;
+
+//Script key names
+struct ScriptKey
+{
+    const char* name;
+    SDL_Keycode key;
+};
+
+static const ScriptKey SCRIPT_KEYS[] =
+{
+    { "w", SDLK_w },
+    { "s", SDLK_s },
+    { "up", SDLK_UP },
+    { "down", SDLK_DOWN },
+    { "space", SDLK_SPACE },
+    { "escape", SDLK_ESCAPE }
+};
+
+//FNV-1a over the pixels with alpha ignored, so a renderer that leaves
+//alpha undefined hashes the same
+static Uint64 hashPixels( const Uint32* pixels, size_t count )
+{
+    Uint64 hash = 0xCBF29CE484222325ull;
+    for( size_t i = 0; i < count; ++i )
+    {
+        hash = ( hash ^ ( pixels[ i ] & 0x00FFFFFF ) ) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+//Nearest-rank percentile of sorted times
+static double percentile( const vector<double>& sorted, double p )
+{
+    if( sorted.empty() )
+    {
+        return 0.0;
+    }
+
+    size_t rank = (size_t)( p * sorted.size() + 0.999999 );
+    return sorted[ rank > 0 ? rank - 1 : 0 ];
+}
+
+//Writes a string with JSON escapes
+static void writeJsonString( FILE* file, const string& text )
+{
+    fputc( '"', file );
+    for( size_t i = 0; i < text.size(); ++i )
+    {
+        char c = text[ i ];
+        if( c == '"' || c == '\\' )
+        {
+            fputc( '\\', file );
+            fputc( c, file );
+        }
+        else if( (unsigned char)c < 0x20 )
+        {
+            fprintf( file, "\\u%04x", c );
+        }
+        else
+        {
+            fputc( c, file );
+        }
+    }
+    fputc( '"', file );
+}
+
+static bool stepBefore( const ScriptStep& a, const ScriptStep& b )
+{
+    return a.frame < b.frame;
+}
+
+FrameHarness::FrameHarness()
+{
+    //Initialize
+    mNextStep = 0;
+    mEndFrame = 0;
+    mSeed = 0;
+    mActive = false;
+    mFrame = 0;
+    mFrameStart = 0;
+    mSnapshotDue = false;
+    mCheckTicks = 0;
+}
+
+bool FrameHarness::start( string scriptPath, string goldenDir, string reportPath, Uint32 seed )
+{
+    if( !loadScript( scriptPath ) )
+    {
+        return false;
+    }
+
+    mScriptPath = scriptPath;
+    mGoldenDir = goldenDir;
+    mReportPath = reportPath;
+    mSeed = seed;
+    mNextStep = 0;
+    mFrame = 0;
+    mFrameTimes.clear();
+    mFrameTimes.reserve( mEndFrame );
+    mSnapshots.clear();
+    mActive = true;
+
+    return true;
+}
+
+bool FrameHarness::isActive()
+{
+    return mActive;
+}
+
+void FrameHarness::beginFrame()
+{
+    mFrameStart = SDL_GetPerformanceCounter();
+    mCheckTicks = 0;
+    mSnapshotDue = false;
+
+    //Queue this frame's input where SDL_PollEvent will find it
+    while( mNextStep < mSteps.size() && mSteps[ mNextStep ].frame <= mFrame )
+    {
+        const ScriptStep& step = mSteps[ mNextStep++ ];
+        if( step.action == SCRIPT_SNAPSHOT )
+        {
+            mSnapshotDue = true;
+        }
+        else if( step.action == SCRIPT_KEY_DOWN || step.action == SCRIPT_KEY_UP )
+        {
+            SDL_Event e;
+            memset( &e, 0, sizeof( e ) );
+            e.type = step.action == SCRIPT_KEY_DOWN ? SDL_KEYDOWN : SDL_KEYUP;
+            e.key.timestamp = SDL_GetTicks();
+            e.key.state = step.action == SCRIPT_KEY_DOWN ? SDL_PRESSED : SDL_RELEASED;
+            e.key.repeat = 0;
+            e.key.keysym.sym = step.key;
+            e.key.keysym.scancode = SDL_GetScancodeFromKey( step.key );
+            if( SDL_PushEvent( &e ) < 0 )
+            {
+                printf( "Unable to push scripted event! SDL Error: %s\n", SDL_GetError() );
+            }
+        }
+    }
+}
+
+void FrameHarness::checkFrame( SDL_Renderer* renderer, int width, int height )
+{
+    if( !mSnapshotDue )
+    {
+        return;
+    }
+
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    FrameSnapshot snapshot;
+    snapshot.frame = mFrame;
+    snapshot.hash = 0;
+    snapshot.diffPixels = 0;
+
+    mPixels.resize( (size_t)width * height );
+    if( SDL_RenderReadPixels( renderer, NULL, SDL_PIXELFORMAT_ABGR8888, &mPixels[ 0 ], width * 4 ) != 0 )
+    {
+        printf( "Unable to read back frame %u! SDL Error: %s\n", (unsigned)mFrame, SDL_GetError() );
+        snapshot.golden = "unreadable";
+    }
+    else
+    {
+        snapshot.hash = hashPixels( &mPixels[ 0 ], mPixels.size() );
+        compareGolden( snapshot, width, height );
+    }
+    mSnapshots.push_back( snapshot );
+
+    mCheckTicks += SDL_GetPerformanceCounter() - start;
+}
+
+bool FrameHarness::endFrame()
+{
+    Uint64 ticks = SDL_GetPerformanceCounter() - mFrameStart - mCheckTicks;
+    mFrameTimes.push_back( ticks * 1000.0 / SDL_GetPerformanceFrequency() );
+
+    mFrame++;
+    return mFrame < mEndFrame;
+}
+
+void FrameHarness::stop()
+{
+    if( !mActive )
+    {
+        return;
+    }
+    mActive = false;
+
+    if( !writeReport() )
+    {
+        printf( "Unable to write harness report %s!\n", mReportPath.c_str() );
+    }
+}
+
+bool FrameHarness::loadScript( string path )
+{
+    FILE* file = fopen( path.c_str(), "r" );
+    if( file == NULL )
+    {
+        printf( "Unable to open script %s!\n", path.c_str() );
+        return false;
+    }
+
+    mSteps.clear();
+    mEndFrame = 0;
+    bool ended = false;
+    bool success = true;
+    char line[ 256 ];
+    for( int number = 1; fgets( line, sizeof( line ), file ) != NULL; ++number )
+    {
+        //Drop comments
+        char* comment = strchr( line, '#' );
+        if( comment != NULL )
+        {
+            *comment = '\0';
+        }
+
+        unsigned frame;
+        char action[ 32 ] = "";
+        char key[ 32 ] = "";
+        int fields = sscanf( line, "%u %31s %31s", &frame, action, key );
+        if( fields <= 0 )
+        {
+            continue;
+        }
+
+        ScriptStep step;
+        step.frame = frame;
+        step.key = SDLK_UNKNOWN;
+        bool valid = fields >= 2;
+        if( strcmp( action, "down" ) == 0 || strcmp( action, "up" ) == 0 )
+        {
+            step.action = action[ 0 ] == 'd' ? SCRIPT_KEY_DOWN : SCRIPT_KEY_UP;
+            for( size_t i = 0; i < sizeof( SCRIPT_KEYS ) / sizeof( SCRIPT_KEYS[ 0 ] ); ++i )
+            {
+                if( strcmp( key, SCRIPT_KEYS[ i ].name ) == 0 )
+                {
+                    step.key = SCRIPT_KEYS[ i ].key;
+                }
+            }
+            valid = valid && step.key != SDLK_UNKNOWN;
+        }
+        else if( strcmp( action, "snapshot" ) == 0 )
+        {
+            step.action = SCRIPT_SNAPSHOT;
+        }
+        else if( strcmp( action, "end" ) == 0 )
+        {
+            step.action = SCRIPT_END;
+            if( !ended || frame < mEndFrame )
+            {
+                mEndFrame = frame;
+            }
+            ended = true;
+        }
+        else
+        {
+            valid = false;
+        }
+
+        if( !valid )
+        {
+            printf( "Bad line %d in script %s!\n", number, path.c_str() );
+            success = false;
+            break;
+        }
+        mSteps.push_back( step );
+    }
+    fclose( file );
+
+    //Without an end, run one frame past the last step
+    stable_sort( mSteps.begin(), mSteps.end(), stepBefore );
+    if( !ended )
+    {
+        mEndFrame = mSteps.empty() ? 0 : mSteps.back().frame + 1;
+    }
+
+    if( success && mEndFrame == 0 )
+    {
+        printf( "Script %s has no frames to run!\n", path.c_str() );
+        success = false;
+    }
+
+    return success;
+}
+
+void FrameHarness::compareGolden( FrameSnapshot& snapshot, int width, int height )
+{
+    if( mGoldenDir.empty() )
+    {
+        snapshot.golden = "none";
+        return;
+    }
+
+    char name[ 32 ];
+    snprintf( name, sizeof( name ), "/frame_%06u.bmp", (unsigned)snapshot.frame );
+    string path = mGoldenDir + name;
+
+    SDL_Surface* golden = SDL_LoadBMP( path.c_str() );
+    if( golden == NULL )
+    {
+        //First run, this frame becomes the golden image
+        SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat( 0, width, height, 32, SDL_PIXELFORMAT_ABGR8888 );
+        if( surface == NULL )
+        {
+            printf( "Unable to create golden image! SDL Error: %s\n", SDL_GetError() );
+            snapshot.golden = "none";
+            return;
+        }
+
+        for( int y = 0; y < height; ++y )
+        {
+            memcpy( (Uint8*)surface->pixels + y * surface->pitch, &mPixels[ (size_t)y * width ], width * 4 );
+        }
+
+        if( SDL_SaveBMP( surface, path.c_str() ) != 0 )
+        {
+            printf( "Unable to save golden image %s! SDL Error: %s\n", path.c_str(), SDL_GetError() );
+            snapshot.golden = "none";
+        }
+        else
+        {
+            snapshot.golden = "new";
+        }
+        SDL_FreeSurface( surface );
+        return;
+    }
+
+    SDL_Surface* converted = SDL_ConvertSurfaceFormat( golden, SDL_PIXELFORMAT_ABGR8888, 0 );
+    SDL_FreeSurface( golden );
+    if( converted == NULL || converted->w != width || converted->h != height )
+    {
+        snapshot.golden = "mismatch";
+        snapshot.diffPixels = width * height;
+        SDL_FreeSurface( converted );
+        return;
+    }
+
+    //Count the pixels that changed, alpha ignored like the hash
+    for( int y = 0; y < height; ++y )
+    {
+        const Uint32* row = (const Uint32*)( (const Uint8*)converted->pixels + y * converted->pitch );
+        const Uint32* frame = &mPixels[ (size_t)y * width ];
+        for( int x = 0; x < width; ++x )
+        {
+            if( ( row[ x ] ^ frame[ x ] ) & 0x00FFFFFF )
+            {
+                snapshot.diffPixels++;
+            }
+        }
+    }
+    SDL_FreeSurface( converted );
+
+    snapshot.golden = snapshot.diffPixels == 0 ? "match" : "mismatch";
+}
+
+bool FrameHarness::writeReport()
+{
+    FILE* file = fopen( mReportPath.c_str(), "w" );
+    if( file == NULL )
+    {
+        return false;
+    }
+
+    vector<double> sorted = mFrameTimes;
+    sort( sorted.begin(), sorted.end() );
+    double total = 0.0;
+    for( size_t i = 0; i < sorted.size(); ++i )
+    {
+        total += sorted[ i ];
+    }
+
+    Uint32 histogram[ HISTOGRAM_BUCKETS ] = { 0 };
+    for( size_t i = 0; i < sorted.size(); ++i )
+    {
+        int bucket = (int)( sorted[ i ] / HISTOGRAM_BUCKET_MS );
+        histogram[ bucket < HISTOGRAM_BUCKETS ? bucket : HISTOGRAM_BUCKETS - 1 ]++;
+    }
+
+    const char* driver = SDL_GetCurrentVideoDriver();
+
+    //One value per line so tools/frame_regress can read it without a JSON library
+    fprintf( file, "{\n" );
+    fprintf( file, "  \"script\": " );
+    writeJsonString( file, mScriptPath );
+    fprintf( file, ",\n" );
+    fprintf( file, "  \"seed\": %u,\n", (unsigned)mSeed );
+    fprintf( file, "  \"build\": \"%s %s\",\n", __DATE__, __TIME__ );
+    fprintf( file, "  \"video_driver\": " );
+    writeJsonString( file, driver != NULL ? driver : "" );
+    fprintf( file, ",\n" );
+    fprintf( file, "  \"frames\": %u,\n", (unsigned)sorted.size() );
+    fprintf( file, "  \"mean_ms\": %.4f,\n", sorted.empty() ? 0.0 : total / sorted.size() );
+    fprintf( file, "  \"p50_ms\": %.4f,\n", percentile( sorted, 0.50 ) );
+    fprintf( file, "  \"p90_ms\": %.4f,\n", percentile( sorted, 0.90 ) );
+    fprintf( file, "  \"p99_ms\": %.4f,\n", percentile( sorted, 0.99 ) );
+    fprintf( file, "  \"max_ms\": %.4f,\n", sorted.empty() ? 0.0 : sorted.back() );
+
+    fprintf( file, "  \"histogram_bucket_ms\": %.2f,\n", HISTOGRAM_BUCKET_MS );
+    fprintf( file, "  \"histogram\": [" );
+    for( int i = 0; i < HISTOGRAM_BUCKETS; ++i )
+    {
+        fprintf( file, i == 0 ? "%u" : ", %u", (unsigned)histogram[ i ] );
+    }
+    fprintf( file, "],\n" );
+
+    fprintf( file, "  \"snapshots\": [\n" );
+    for( size_t i = 0; i < mSnapshots.size(); ++i )
+    {
+        const FrameSnapshot& snapshot = mSnapshots[ i ];
+        fprintf( file, "    { \"frame\": %u, \"hash\": \"%016llx\", \"golden\": \"%s\", \"diff_pixels\": %u }%s\n", (unsigned)snapshot.frame, (unsigned long long)snapshot.hash, snapshot.golden.c_str(), (unsigned)snapshot.diffPixels, i + 1 < mSnapshots.size() ? "," : "" );
+    }
+    fprintf( file, "  ],\n" );
+
+    //Raw times in frame order
+    fprintf( file, "  \"frame_ms\": [" );
+    for( size_t i = 0; i < mFrameTimes.size(); ++i )
+    {
+        fprintf( file, i == 0 ? "%.4f" : ", %.4f", mFrameTimes[ i ] );
+    }
+    fprintf( file, "]\n" );
+    fprintf( file, "}\n" );
+
+    return fclose( file ) == 0;
+}
@@ -0,0 +1,129 @@
+/*
+Scripted frame-time harness.
+
+Plays an input script through the game's own event loop: on each frame the
+script's key presses are pushed onto SDL's queue as synthetic events, so
+Paddle::handleEvent and Ball::startEvent see exactly what a keyboard would
+send. Every frame's time is recorded, and the frames the script marks are
+read back, hashed and compared with golden images. The run ends with a JSON
+report that tools/frame_regress compares between two builds.
+
+Script lines are "<frame> <action> [key]", '#' starts a comment:
+
+    0    down space
+    30   down w
+    75   up   w
+    120  snapshot
+    600  end
+
+Actions are down, up, snapshot and end; keys are w, s, up, down, space and
+escape.
+*/
+
+#ifndef HARNESS_H
+#define HARNESS_H
+
+#include <SDL.h>
+#include <string>
+#include <vector>
+
+//Script actions
+enum ScriptAction
+{
+    SCRIPT_KEY_DOWN,
+    SCRIPT_KEY_UP,
+    SCRIPT_SNAPSHOT,
+    SCRIPT_END
+};
+
+//One line of an input script
+struct ScriptStep
+{
+    Uint32 frame;
+    ScriptAction action;
+    SDL_Keycode key;
+};
+
+//A frame the script asked to check
+struct FrameSnapshot
+{
+    Uint32 frame;
+    Uint64 hash;
+
+    //"match", "mismatch" or "new" when there was no golden image yet
+    std::string golden;
+
+    //Pixels that differ from the golden image
+    Uint32 diffPixels;
+};
+
+//Scripted run wrapper class
+class FrameHarness
+{
+    public:
+        //Initializes variables
+        FrameHarness();
+
+        //Loads the script. Snapshots are checked against goldenDir, and the
+        //report goes to reportPath when the run stops
+        bool start( std::string scriptPath, std::string goldenDir, std::string reportPath, Uint32 seed );
+
+        //Checks if a script is running
+        bool isActive();
+
+        //Pushes the script's key events for this frame, call before polling
+        void beginFrame();
+
+        //Reads back and checks the frame if the script marks it, call
+        //before SDL_RenderPresent
+        void checkFrame( SDL_Renderer* renderer, int width, int height );
+
+        //Records the frame time, returns false when the script has ended
+        bool endFrame();
+
+        //Writes the report
+        void stop();
+
+    private:
+        //Parses the script file
+        bool loadScript( std::string path );
+
+        //Compares a frame with its golden image, saving it if there is none
+        void compareGolden( FrameSnapshot& snapshot, int width, int height );
+
+        //Writes the JSON report
+        bool writeReport();
+
+        //Script, sorted by frame
+        std::vector<ScriptStep> mSteps;
+        size_t mNextStep;
+        Uint32 mEndFrame;
+
+        //Run settings
+        std::string mScriptPath;
+        std::string mGoldenDir;
+        std::string mReportPath;
+        Uint32 mSeed;
+        bool mActive;
+
+        //Current frame and when it started
+        Uint32 mFrame;
+        Uint64 mFrameStart;
+
+        //The script marks this frame for checking
+        bool mSnapshotDue;
+
+        //Time spent reading back snapshots, left out of the frame time
+        Uint64 mCheckTicks;
+
+        //Frame times in ms
+        std::vector<double> mFrameTimes;
+
+        //Checked frames
+        std::vector<FrameSnapshot> mSnapshots;
+
+        //Read back pixels
+        std::vector<Uint32> mPixels;
+};
+
+#endif
@@ -0,0 +1,246 @@
+/*
+Columnar match-analytics log format.
+*/
+
+#include "matchlog.h"
+
+using namespace std;
+
+//Encoding picked for each column
+static const uint8_t COLUMN_ENCODINGS[ COLUMN_COUNT ] =
+{
+    ENCODING_DELTA_VARINT,  //tick only ever grows
+    ENCODING_RLE_VARINT,    //type
+    ENCODING_RLE_VARINT,    //player
+    ENCODING_VARINT,        //ball x
+    ENCODING_VARINT,        //ball y
+    ENCODING_RLE_VARINT,    //ball x velocity changes rarely
+    ENCODING_RLE_VARINT,    //ball y velocity changes rarely
+    ENCODING_VARINT,        //contact offset
+    ENCODING_VARINT         //rally length
+};
+
+//Maps signed values to unsigned so small magnitudes stay short
+static uint32_t zigzag( int32_t value )
+{
+    return ( (uint32_t)value << 1 ) ^ (uint32_t)( value >> 31 );
+}
+
+static int32_t unzigzag( uint32_t value )
+{
+    return (int32_t)( value >> 1 ) ^ -(int32_t)( value & 1 );
+}
+
+static void putVarint( vector<uint8_t>& out, uint32_t value )
+{
+    while( value >= 0x80 )
+    {
+        out.push_back( (uint8_t)( value | 0x80 ) );
+        value >>= 7;
+    }
+    out.push_back( (uint8_t)value );
+}
+
+static bool getVarint( const uint8_t*& in, const uint8_t* end, uint32_t& value )
+{
+    value = 0;
+    for( int shift = 0; shift < 35 && in < end; shift += 7 )
+    {
+        uint8_t byte = *in++;
+        value |= (uint32_t)( byte & 0x7F ) << shift;
+        if( !( byte & 0x80 ) )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+int32_t matchLogValue( const MatchEvent& event, int column )
+{
+    switch( column )
+    {
+        case COLUMN_TICK: return (int32_t)event.tick;
+        case COLUMN_TYPE: return event.type;
+        case COLUMN_PLAYER: return event.player;
+        case COLUMN_BALL_X: return event.ballX;
+        case COLUMN_BALL_Y: return event.ballY;
+        case COLUMN_BALL_VEL_X: return event.ballVelX;
+        case COLUMN_BALL_VEL_Y: return event.ballVelY;
+        case COLUMN_CONTACT_OFFSET: return event.contactOffset;
+        case COLUMN_RALLY_LENGTH: return event.rallyLength;
+    }
+    return 0;
+}
+
+void matchLogSetValue( MatchEvent& event, int column, int32_t value )
+{
+    switch( column )
+    {
+        case COLUMN_TICK: event.tick = (uint32_t)value; break;
+        case COLUMN_TYPE: event.type = value; break;
+        case COLUMN_PLAYER: event.player = value; break;
+        case COLUMN_BALL_X: event.ballX = value; break;
+        case COLUMN_BALL_Y: event.ballY = value; break;
+        case COLUMN_BALL_VEL_X: event.ballVelX = value; break;
+        case COLUMN_BALL_VEL_Y: event.ballVelY = value; break;
+        case COLUMN_CONTACT_OFFSET: event.contactOffset = value; break;
+        case COLUMN_RALLY_LENGTH: event.rallyLength = value; break;
+    }
+}
+
+bool matchLogWriteGroup( FILE* file, const MatchEvent* events, uint32_t count, vector<uint8_t>& scratch )
+{
+    if( count == 0 )
+    {
+        return true;
+    }
+
+    MatchLogGroupHeader group;
+    group.magic = MATCHLOG_GROUP_MAGIC;
+    group.rowCount = count;
+    group.columnCount = COLUMN_COUNT;
+    if( fwrite( &group, sizeof( group ), 1, file ) != 1 )
+    {
+        return false;
+    }
+
+    for( int column = 0; column < COLUMN_COUNT; ++column )
+    {
+        MatchLogColumnHeader header;
+        header.column = (uint8_t)column;
+        header.encoding = COLUMN_ENCODINGS[ column ];
+        header.reserved = 0;
+        header.minValue = matchLogValue( events[ 0 ], column );
+        header.maxValue = header.minValue;
+
+        scratch.clear();
+        int32_t previous = 0;
+        for( uint32_t row = 0; row < count; ++row )
+        {
+            int32_t value = matchLogValue( events[ row ], column );
+            header.minValue = value < header.minValue ? value : header.minValue;
+            header.maxValue = value > header.maxValue ? value : header.maxValue;
+
+            switch( header.encoding )
+            {
+                case ENCODING_VARINT:
+                    putVarint( scratch, zigzag( value ) );
+                    break;
+
+                case ENCODING_DELTA_VARINT:
+                    putVarint( scratch, zigzag( value - previous ) );
+                    previous = value;
+                    break;
+
+                case ENCODING_RLE_VARINT:
+                {
+                    //Value then how many rows repeat it
+                    uint32_t run = 1;
+                    while( row + run < count && matchLogValue( events[ row + run ], column ) == value )
+                    {
+                        run++;
+                    }
+                    putVarint( scratch, zigzag( value ) );
+                    putVarint( scratch, run );
+                    row += run - 1;
+                    break;
+                }
+            }
+        }
+
+        header.byteLength = (uint32_t)scratch.size();
+        if( fwrite( &header, sizeof( header ), 1, file ) != 1 || fwrite( &scratch[ 0 ], 1, scratch.size(), file ) != scratch.size() )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool matchLogReadGroup( FILE* file, MatchLogGroupHeader& group )
+{
+    if( fread( &group, sizeof( group ), 1, file ) != 1 )
+    {
+        return false;
+    }
+
+    if( group.magic != MATCHLOG_GROUP_MAGIC )
+    {
+        printf( "Corrupt row group in match log!\n" );
+        return false;
+    }
+
+    return true;
+}
+
+bool matchLogReadColumn( FILE* file, uint32_t rowCount, const bool wanted[ COLUMN_COUNT ], MatchLogColumnHeader& header, vector<int32_t> columns[ COLUMN_COUNT ], vector<uint8_t>& scratch )
+{
+    if( fread( &header, sizeof( header ), 1, file ) != 1 )
+    {
+        return false;
+    }
+
+    //Skip the bytes of columns nobody asked for, or that a newer writer added
+    if( header.column >= COLUMN_COUNT || !wanted[ header.column ] )
+    {
+        return fseek( file, header.byteLength, SEEK_CUR ) == 0;
+    }
+
+    scratch.resize( header.byteLength );
+    if( header.byteLength > 0 && fread( &scratch[ 0 ], 1, header.byteLength, file ) != header.byteLength )
+    {
+        return false;
+    }
+
+    vector<int32_t>& values = columns[ header.column ];
+    values.resize( rowCount );
+    const uint8_t* in = scratch.empty() ? NULL : &scratch[ 0 ];
+    const uint8_t* end = in + scratch.size();
+    int32_t previous = 0;
+    uint32_t row = 0;
+    while( row < rowCount )
+    {
+        uint32_t encoded;
+        if( !getVarint( in, end, encoded ) )
+        {
+            printf( "Corrupt column in match log!\n" );
+            return false;
+        }
+
+        switch( header.encoding )
+        {
+            case ENCODING_VARINT:
+                values[ row++ ] = unzigzag( encoded );
+                break;
+
+            case ENCODING_DELTA_VARINT:
+                previous += unzigzag( encoded );
+                values[ row++ ] = previous;
+                break;
+
+            case ENCODING_RLE_VARINT:
+            {
+                uint32_t run;
+                if( !getVarint( in, end, run ) || run > rowCount - row )
+                {
+                    printf( "Corrupt column in match log!\n" );
+                    return false;
+                }
+                int32_t value = unzigzag( encoded );
+                while( run-- > 0 )
+                {
+                    values[ row++ ] = value;
+                }
+                break;
+            }
+
+            default:
+                printf( "Unknown column encoding in match log!\n" );
+                return false;
+        }
+    }
+
+    return true;
+}
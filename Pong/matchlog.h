@@ -0,0 +1,122 @@
+/*
+Columnar match-analytics log format.
+
+A log is a file header followed by row groups. Each row group stores its
+events column by column, every column compressed on its own (deltas,
+run lengths and zigzag varints) and prefixed with its byte length and
+min/max, so a reader can skip columns and whole groups it doesn't need.
+*/
+
+#ifndef MATCHLOG_H
+#define MATCHLOG_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+//File and row group identification
+const uint32_t MATCHLOG_MAGIC = 0x31414D50; /* "PMA1" */
+const uint32_t MATCHLOG_GROUP_MAGIC = 0x50524752; /* "RGRP" */
+const uint32_t MATCHLOG_VERSION = 1;
+
+//Event types
+enum MatchEventType
+{
+    EVENT_PADDLE_HIT,
+    EVENT_WALL_BOUNCE,
+    EVENT_POINT,
+    EVENT_TYPE_COUNT
+};
+
+//One analytics event, also a row of the log
+struct MatchEvent
+{
+    //Simulation tick the event happened on
+    uint32_t tick;
+
+    //MatchEventType
+    int32_t type;
+
+    //Player who hit or scored, 0 for wall bounces
+    int32_t player;
+
+    //Ball position and velocity
+    int32_t ballX, ballY;
+    int32_t ballVelX, ballVelY;
+
+    //Ball centre minus paddle centre on a hit
+    int32_t contactOffset;
+
+    //Paddle hits so far in the rally, the full rally on a point
+    int32_t rallyLength;
+};
+
+//Columns in the order they're stored
+enum MatchLogColumn
+{
+    COLUMN_TICK,
+    COLUMN_TYPE,
+    COLUMN_PLAYER,
+    COLUMN_BALL_X,
+    COLUMN_BALL_Y,
+    COLUMN_BALL_VEL_X,
+    COLUMN_BALL_VEL_Y,
+    COLUMN_CONTACT_OFFSET,
+    COLUMN_RALLY_LENGTH,
+    COLUMN_COUNT
+};
+
+//How a column is compressed
+enum MatchLogEncoding
+{
+    ENCODING_VARINT,
+    ENCODING_DELTA_VARINT,
+    ENCODING_RLE_VARINT
+};
+
+//Start of the file
+struct MatchLogHeader
+{
+    uint32_t magic;
+    uint32_t version;
+
+    //Wall clock time the match started, seconds since the epoch
+    uint64_t startTime;
+};
+
+//Start of each column inside a row group
+struct MatchLogColumnHeader
+{
+    uint8_t column;
+    uint8_t encoding;
+    uint16_t reserved;
+    int32_t minValue;
+    int32_t maxValue;
+    uint32_t byteLength;
+};
+
+//Start of each row group
+struct MatchLogGroupHeader
+{
+    uint32_t magic;
+    uint32_t rowCount;
+    uint32_t columnCount;
+};
+
+//Gets a column of an event
+int32_t matchLogValue( const MatchEvent& event, int column );
+
+//Sets a column of an event
+void matchLogSetValue( MatchEvent& event, int column, int32_t value );
+
+//Writes events as one row group, returns false on an I/O error
+bool matchLogWriteGroup( FILE* file, const MatchEvent* events, uint32_t count, std::vector<uint8_t>& scratch );
+
+//Reads the next row group header, returns false at the end of the file
+bool matchLogReadGroup( FILE* file, MatchLogGroupHeader& group );
+
+//Reads the next column of the current row group into columns[ column ].
+//Columns not flagged in wanted are skipped without decoding
+bool matchLogReadColumn( FILE* file, uint32_t rowCount, const bool wanted[ COLUMN_COUNT ], MatchLogColumnHeader& header, std::vector<int32_t> columns[ COLUMN_COUNT ], std::vector<uint8_t>& scratch );
+
+#endif
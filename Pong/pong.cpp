@@ -15,6 +15,13 @@ Cite: LazyFoo Productions SDL tutorials <http://lazyfoo.net/tutorials/SDL/>
 #include <cmath>
 #include <stdlib.h>
 #include <time.h>
+#include <type_traits>
+#include "pong_shm.h"
+#include "capture.h"
+#include "softrender.h"
+#include "analytics.h"
+#include "checkpoint.h"
+#include "harness.h"
 using namespace std;
 
 #ifdef __MINGW32__
@@ -28,10 +35,45 @@ const int SCREEN_HEIGHT = 600;
 Uint32 start_time = 0, end_time = 0;
 int delta;
 
-int player1_score;
-int player2_score;
-bool p1_scored;
-bool p2_scored;
+//Bot control region, NULL unless started with --shm
+PongShm* gShm = NULL;
+
+//How long a lockstep tick waits for the bot before running without it
+const Uint32 LOCKSTEP_TIMEOUT_MS = 1000;
+
+//Cleared when a lockstep bot times out, so a bot that died without
+//detaching costs one timeout instead of one per tick. Its next command
+//sets it again
+bool gBotAnswering = true;
+
+//Polls of the command ring before a lockstep tick yields the core
+const int LOCKSTEP_SPINS = 256;
+
+//Present with vsync, turned off with --novsync
+bool gVsync = true;
+
+//Match recording, started with --capture
+FrameCapture gCapture;
+
+//Frames between capture overhead reports
+const Uint32 CAPTURE_REPORT_FRAMES = 300;
+
+//Draw on the CPU instead of through SDL_RenderCopy, set with --cpu-render
+bool gSoftware = false;
+int gSoftThreads = 0;
+SoftRenderer gSoftRenderer;
+
+//Match event log, started with --analytics
+MatchAnalytics gAnalytics;
+
+//Crash-recovery journal, opened with --checkpoint
+MatchJournal gJournal;
+
+//Ticks a checkpoint is spread over, every match is compared once in that many
+const Uint32 CHECKPOINT_TICKS = 60;
+
+//Scripted frame-time run, started with --script
+FrameHarness gHarness;
 
 //Texture wrapper class
 class LTexture
@@ -66,6 +108,9 @@ class LTexture
         //The actual hardware texture
         SDL_Texture* mTexture;
 
+        //The pixels used by the CPU renderer
+        SoftImage* mSoftImage;
+
         //Image dimensions
         int mWidth;
         int mHeight;
@@ -79,6 +124,9 @@ class Paddle
         int mVelX_P1, mVelY_P1;
         int mVelX_P2, mVelY_P2;
 
+        //Paddles driven by a bot ignore the keyboard
+        bool mBot_P1, mBot_P2;
+
     public:
         //The dimensions of the paddle
         static const int PADDLE_WIDTH = 10;
@@ -97,6 +145,17 @@ class Paddle
         //Takes key presses and adjusts the paddle's velocity
         void handleEvent( SDL_Event& e );
 
+        //Takes a bot command and sets the paddle's velocity
+        void handleCommand( const PongCommand& c );
+
+        //Forgets held keys and bot control, for a paddle restored from a
+        //checkpoint whose keyboard and bot are gone
+        void releaseInput();
+
+        //Gets the paddle velocities
+        int getVelY_P1();
+        int getVelY_P2();
+
         //Moves the paddle
         void move();
 
@@ -126,8 +185,11 @@ class Ball
         //Takes key presses and adjusts the paddle's velocity
         void startEvent( SDL_Event& e );
 
-        //Move ball
-        void moveBall();
+        //Launches the ball in a random direction
+        void serve();
+
+        //Move ball, returns true if it bounced off a wall
+        bool moveBall();
 
         //Shows ball
         void render();
@@ -137,6 +199,38 @@ class Ball
 
 };
 
+//Everything that makes up a match in progress, trivially copyable so it
+//can be checkpointed byte for byte
+struct Match
+{
+    //Initializes a new match
+    Match();
+
+    Paddle paddle;
+    Ball ball;
+
+    int player1_score;
+    int player2_score;
+    bool p1_scored;
+    bool p2_scored;
+
+    //Paddle hits since the last serve
+    int rallyLength;
+
+    //Simulation tick, shared with the bot and stamped on analytics. Keep it
+    //last, checkpoints leave it out of their comparison
+    Uint32 tick;
+};
+
+//Bytes of a Match a checkpoint compares, everything but tick
+const uint32_t MATCH_COMPARE_SIZE = sizeof( Match ) - sizeof( Uint32 );
+
+//Bytes per journal file, a few hundred checkpoints of the one match before
+//the journal rolls over to the other file
+const uint64_t CHECKPOINT_CAPACITY = 64 << 10;
+
+static_assert( std::is_trivially_copyable<Match>::value, "Match must stay trivially copyable for checkpoints" );
+
 //Starts up SDL and creates window
 bool init();
 
@@ -152,6 +246,12 @@ bool checkCollision( SDL_Rect a, SDL_Rect b );
 //ball angle
 int Ball_angle(int p_y, int b_y);
 
+//Sends the current state to the bot and applies its commands
+void exchangeWithBot( Match& match );
+
+//Queues an analytics event for the ball's current state
+void logMatchEvent( Match& match, int type, int player, int contactOffset );
+
 //The window we'll be rendering to
 SDL_Window* gWindow = NULL;
 
@@ -183,6 +283,7 @@ LTexture::LTexture()
 {
     //Initialize
     mTexture = NULL;
+    mSoftImage = NULL;
     mWidth = 0;
     mHeight = 0;
 }
@@ -212,17 +313,37 @@ bool LTexture::loadFromFile( std::string path )
         //Color key image
         SDL_SetColorKey( loadedSurface, SDL_TRUE, SDL_MapRGB( loadedSurface->format, 0xFF, 0xE3, 0xA0 ) );
 
-        //Create texture from surface pixels
-        newTexture = SDL_CreateTextureFromSurface( gRenderer, loadedSurface );
-        if( newTexture == NULL )
+        if( gSoftware )
         {
-            printf( "Unable to create texture from %s! SDL Error: %s\n", path.c_str(), SDL_GetError() );
+            //Keep the pixels on the CPU
+            mSoftImage = new SoftImage();
+            if( !mSoftImage->loadFromSurface( loadedSurface ) )
+            {
+                printf( "Unable to load %s for software rendering!\n", path.c_str() );
+                delete mSoftImage;
+                mSoftImage = NULL;
+            }
+            else
+            {
+                //Get image dimensions
+                mWidth = loadedSurface->w;
+                mHeight = loadedSurface->h;
+            }
         }
         else
         {
-            //Get image dimensions
-            mWidth = loadedSurface->w;
-            mHeight = loadedSurface->h;
+            //Create texture from surface pixels
+            newTexture = SDL_CreateTextureFromSurface( gRenderer, loadedSurface );
+            if( newTexture == NULL )
+            {
+                printf( "Unable to create texture from %s! SDL Error: %s\n", path.c_str(), SDL_GetError() );
+            }
+            else
+            {
+                //Get image dimensions
+                mWidth = loadedSurface->w;
+                mHeight = loadedSurface->h;
+            }
         }
 
         //Get rid of old loaded surface
@@ -231,7 +352,7 @@ bool LTexture::loadFromFile( std::string path )
 
     //Return success
     mTexture = newTexture;
-    return mTexture != NULL;
+    return mTexture != NULL || mSoftImage != NULL;
 }
 
 bool LTexture::loadFromRenderedText( string textureText, SDL_Color textColor )
@@ -247,17 +368,37 @@ bool LTexture::loadFromRenderedText( string textureText, SDL_Color textColor )
     }
     else
     {
-        //Create texture from surface pixels
-        mTexture = SDL_CreateTextureFromSurface( gRenderer, textSurface );
-        if( mTexture == NULL )
+        if( gSoftware )
         {
-            printf( "Unable to create texture from rendered text! SDL Error: %s\n", SDL_GetError() );
+            //Keep the pixels on the CPU
+            mSoftImage = new SoftImage();
+            if( !mSoftImage->loadFromSurface( textSurface ) )
+            {
+                printf( "Unable to load rendered text for software rendering!\n" );
+                delete mSoftImage;
+                mSoftImage = NULL;
+            }
+            else
+            {
+                //Get image dimensions
+                mWidth = textSurface->w;
+                mHeight = textSurface->h;
+            }
         }
         else
         {
-            //Get image dimensions
-            mWidth = textSurface->w;
-            mHeight = textSurface->h;
+            //Create texture from surface pixels
+            mTexture = SDL_CreateTextureFromSurface( gRenderer, textSurface );
+            if( mTexture == NULL )
+            {
+                printf( "Unable to create texture from rendered text! SDL Error: %s\n", SDL_GetError() );
+            }
+            else
+            {
+                //Get image dimensions
+                mWidth = textSurface->w;
+                mHeight = textSurface->h;
+            }
         }
 
         //Get rid of old surface
@@ -265,7 +406,7 @@ bool LTexture::loadFromRenderedText( string textureText, SDL_Color textColor )
     }
 
     //Return success
-    return mTexture != NULL;
+    return mTexture != NULL || mSoftImage != NULL;
 }
 
 void LTexture::free()
@@ -278,12 +419,28 @@ void LTexture::free()
         mWidth = 0;
         mHeight = 0;
     }
+
+    //Free software pixels if they exist
+    if( mSoftImage != NULL )
+    {
+        delete mSoftImage;
+        mSoftImage = NULL;
+        mWidth = 0;
+        mHeight = 0;
+    }
 }
 
 void LTexture::setColor( Uint8 red, Uint8 green, Uint8 blue )
 {
     //Modulate texture rgb
-    SDL_SetTextureColorMod( mTexture, red, green, blue );
+    if( mSoftImage != NULL )
+    {
+        mSoftImage->setColor( red, green, blue );
+    }
+    else
+    {
+        SDL_SetTextureColorMod( mTexture, red, green, blue );
+    }
 }
 
 void LTexture::render( int x, int y, SDL_Rect* clip)
@@ -299,7 +456,14 @@ void LTexture::render( int x, int y, SDL_Rect* clip)
     }
 
     //Render to screen
-    SDL_RenderCopy ( gRenderer, mTexture, clip, &renderQuad);
+    if( mSoftImage != NULL )
+    {
+        gSoftRenderer.blit( mSoftImage, x, y, clip );
+    }
+    else
+    {
+        SDL_RenderCopy ( gRenderer, mTexture, clip, &renderQuad);
+    }
 }
 int LTexture::getWidth()
 {
@@ -328,6 +492,10 @@ Paddle::Paddle()
     mVelY_P1 = 0;
     mVelX_P2 = 0;
     mVelY_P2 = 0;
+
+    //Keyboard until a bot says otherwise
+    mBot_P1 = false;
+    mBot_P2 = false;
 }
 void Paddle::handleEvent( SDL_Event& e )
 {
@@ -337,10 +505,10 @@ void Paddle::handleEvent( SDL_Event& e )
         //Adjust the velocity
         switch( e.key.keysym.sym )
         {
-            case SDLK_w: mVelY_P1 -= PADDLE_VEL; break;
-            case SDLK_s: mVelY_P1 += PADDLE_VEL; break;
-            case SDLK_UP: mVelY_P2 -= PADDLE_VEL; break;
-            case SDLK_DOWN: mVelY_P2 += PADDLE_VEL; break;
+            case SDLK_w: if( !mBot_P1 ) mVelY_P1 -= PADDLE_VEL; break;
+            case SDLK_s: if( !mBot_P1 ) mVelY_P1 += PADDLE_VEL; break;
+            case SDLK_UP: if( !mBot_P2 ) mVelY_P2 -= PADDLE_VEL; break;
+            case SDLK_DOWN: if( !mBot_P2 ) mVelY_P2 += PADDLE_VEL; break;
         }
     }
     //If a key was released
@@ -349,14 +517,53 @@ void Paddle::handleEvent( SDL_Event& e )
         //Adjust the velocity
         switch( e.key.keysym.sym )
         {
-            case SDLK_w: mVelY_P1 += PADDLE_VEL; break;
-            case SDLK_s: mVelY_P1 -= PADDLE_VEL; break;
-            case SDLK_UP: mVelY_P2 += PADDLE_VEL; break;
-            case SDLK_DOWN: mVelY_P2 -= PADDLE_VEL; break;
+            case SDLK_w: if( !mBot_P1 ) mVelY_P1 += PADDLE_VEL; break;
+            case SDLK_s: if( !mBot_P1 ) mVelY_P1 -= PADDLE_VEL; break;
+            case SDLK_UP: if( !mBot_P2 ) mVelY_P2 += PADDLE_VEL; break;
+            case SDLK_DOWN: if( !mBot_P2 ) mVelY_P2 -= PADDLE_VEL; break;
         }
     }
 }
 
+void Paddle::handleCommand( const PongCommand& c )
+{
+    //Set the velocity the keys would have produced
+    if( c.flags & PONG_CMD_P1 )
+    {
+        mBot_P1 = true;
+        mVelY_P1 = ( c.p1_dir > 0 ) - ( c.p1_dir < 0 );
+        mVelY_P1 *= PADDLE_VEL;
+    }
+
+    if( c.flags & PONG_CMD_P2 )
+    {
+        mBot_P2 = true;
+        mVelY_P2 = ( c.p2_dir > 0 ) - ( c.p2_dir < 0 );
+        mVelY_P2 *= PADDLE_VEL;
+    }
+}
+
+void Paddle::releaseInput()
+{
+    //Stand still until a key or a bot command arrives
+    mVelX_P1 = 0;
+    mVelY_P1 = 0;
+    mVelX_P2 = 0;
+    mVelY_P2 = 0;
+    mBot_P1 = false;
+    mBot_P2 = false;
+}
+
+int Paddle::getVelY_P1()
+{
+    return mVelY_P1;
+}
+
+int Paddle::getVelY_P2()
+{
+    return mVelY_P2;
+}
+
 void Paddle::move()
 {
     //Move the paddle up or down
@@ -410,29 +617,34 @@ void Ball::startEvent( SDL_Event& e)
         //Random velocity
         if( e.key.keysym.sym == SDLK_SPACE )
         {
-            if (BallXVel == 0 && BallYVel == 0) //only if the ball is not moving already
-            {
-                if ( rand() % 2 == 0 )
-                {
-                    BallXVel += rand() % BALL_SPEED + 1;
-                    BallYVel += rand() % BALL_SPEED; // * 2;
-                }
+            serve();
+        }
+    }
 
-                if ( rand() % 2 == 1 )
-                {
-                    BallXVel += rand () % (BALL_SPEED + 1) * -1;
-                    BallYVel += (rand() % BALL_SPEED * 2 + 1) * -1;
-                }
+}
 
-                //if (rand() % 2 == 0)
-                //BallYVel = -1;
-            }
+void Ball::serve()
+{
+    if (BallXVel == 0 && BallYVel == 0) //only if the ball is not moving already
+    {
+        if ( rand() % 2 == 0 )
+        {
+            BallXVel += rand() % BALL_SPEED + 1;
+            BallYVel += rand() % BALL_SPEED; // * 2;
+        }
+
+        if ( rand() % 2 == 1 )
+        {
+            BallXVel += rand () % (BALL_SPEED + 1) * -1;
+            BallYVel += (rand() % BALL_SPEED * 2 + 1) * -1;
         }
-    }
 
+        //if (rand() % 2 == 0)
+        //BallYVel = -1;
+    }
 }
 
-void Ball::moveBall()
+bool Ball::moveBall()
 {
     //move the ball
     cBall.x += BallXVel;
@@ -444,7 +656,10 @@ void Ball::moveBall()
         //Move back
         BallYVel = -1 * BallYVel;
         Mix_PlayChannel( -1, gWall, 0 );
+        return true;
     }
+
+    return false;
 }
 
 void Ball::reset()
@@ -462,6 +677,17 @@ void Ball::reset()
     //player2_score
 }
 
+Match::Match()
+{
+    //Paddles and ball start themselves, the rest starts at zero
+    player1_score = 0;
+    player2_score = 0;
+    p1_scored = false;
+    p2_scored = false;
+    rallyLength = 0;
+    tick = 0;
+}
+
 void Ball::render()
 {
     //Show ball
@@ -496,8 +722,20 @@ bool init()
         }
         else
         {
-            //Create vsynced renderer for window
-            gRenderer = SDL_CreateRenderer( gWindow, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC );
+            //Create vsynced renderer for window, the CPU renderer takes
+            //whatever SDL has since it only uploads and copies one texture
+            Uint32 rendererFlags = gSoftware ? 0 : SDL_RENDERER_ACCELERATED;
+
+            //Scripted runs use SDL's software renderer so every machine draws the same pixels
+            if( gHarness.isActive() )
+            {
+                rendererFlags = SDL_RENDERER_SOFTWARE;
+            }
+            if( gVsync )
+            {
+                rendererFlags |= SDL_RENDERER_PRESENTVSYNC;
+            }
+            gRenderer = SDL_CreateRenderer( gWindow, -1, rendererFlags );
             if( gRenderer == NULL )
             {
                 printf( "Renderer could not be created! SDL Error: %s\n", SDL_GetError() );
@@ -508,6 +746,13 @@ bool init()
                 //Initialize renderer color
                 SDL_SetRenderDrawColor( gRenderer, 0x00, 0x00, 0x00, 0xFF );
 
+                //Initialize the CPU renderer
+                if( gSoftware && !gSoftRenderer.init( gRenderer, SCREEN_WIDTH, SCREEN_HEIGHT, gSoftThreads ) )
+                {
+                    printf( "CPU renderer could not initialize!\n" );
+                    success = false;
+                }
+
                 //Initialize PNG loading
                 int imgFlags = IMG_INIT_PNG;
                 if( !( IMG_Init( imgFlags ) & imgFlags ) )
@@ -641,6 +886,122 @@ int Ball_angle(int p_y, int b_y)
     return BallVel;
 }
 
+void exchangeWithBot( Match& match )
+{
+    PongShmRegion* region = pong_shm_region( gShm );
+    Paddle& paddle = match.paddle;
+    Ball& ball = match.ball;
+
+    //Publish this tick's state
+    PongState state;
+    state.tick = match.tick;
+    state.ball_x = ball.cBall.x;
+    state.ball_y = ball.cBall.y;
+    state.ball_vx = ball.BallXVel;
+    state.ball_vy = ball.BallYVel;
+    state.p1_y = paddle.pad_P1.y;
+    state.p1_vy = paddle.getVelY_P1();
+    state.p2_y = paddle.pad_P2.y;
+    state.p2_vy = paddle.getVelY_P2();
+    state.p1_score = match.player1_score;
+    state.p2_score = match.player2_score;
+
+    if( !pong_shm_push_state( region, &state ) )
+    {
+        __atomic_fetch_add( &region->dropped_states, 1, __ATOMIC_RELAXED );
+    }
+
+    PongCommand command;
+
+    //Lockstep waits for the bot to answer this tick
+    if( region->mode == PONG_SHM_LOCKSTEP && gBotAnswering && pong_shm_get_flag( &region->bot_attached ) )
+    {
+        Uint32 waitStart = SDL_GetTicks();
+        bool answered = false;
+        int spins = 0;
+        while( !answered )
+        {
+            while( pong_shm_pop_command( region, &command ) )
+            {
+                paddle.handleCommand( command );
+                if( command.flags & PONG_CMD_SERVE )
+                {
+                    ball.serve();
+                }
+
+                //Older answers are applied but don't end the wait
+                if( command.tick == match.tick )
+                {
+                    answered = true;
+                }
+            }
+
+            if( !answered )
+            {
+                if( !pong_shm_get_flag( &region->bot_attached ) )
+                {
+                    printf( "Bot detached, running without it\n" );
+                    break;
+                }
+
+                if( SDL_GetTicks() - waitStart > LOCKSTEP_TIMEOUT_MS )
+                {
+                    printf( "Bot did not answer tick %u, running without it until it does\n", (unsigned)match.tick );
+                    gBotAnswering = false;
+                    break;
+                }
+
+                //Spin briefly, then let the bot have the core
+                if( ++spins > LOCKSTEP_SPINS )
+                {
+                    SDL_Delay( 0 );
+                    spins = 0;
+                }
+            }
+        }
+    }
+    //Free-running takes whatever has arrived, as does lockstep while the
+    //bot is silent
+    else
+    {
+        while( pong_shm_pop_command( region, &command ) )
+        {
+            if( !gBotAnswering )
+            {
+                printf( "Bot answered again, back to lockstep\n" );
+                gBotAnswering = true;
+            }
+
+            paddle.handleCommand( command );
+            if( command.flags & PONG_CMD_SERVE )
+            {
+                ball.serve();
+            }
+        }
+    }
+}
+
+void logMatchEvent( Match& match, int type, int player, int contactOffset )
+{
+    if( !gAnalytics.isActive() )
+    {
+        return;
+    }
+
+    Ball& ball = match.ball;
+    MatchEvent event;
+    event.tick = match.tick;
+    event.type = type;
+    event.player = player;
+    event.ballX = ball.cBall.x;
+    event.ballY = ball.cBall.y;
+    event.ballVelX = ball.BallXVel;
+    event.ballVelY = ball.BallYVel;
+    event.contactOffset = contactOffset;
+    event.rallyLength = match.rallyLength;
+    gAnalytics.logEvent( event );
+}
+
 void close()
 {
     //Free loaded images
@@ -662,6 +1023,23 @@ void close()
     gWindow = NULL;
     gRenderer = NULL;
 
+    //Finish writing the recording and the match log
+    gCapture.stop();
+    gAnalytics.stop();
+
+    //Flush the last checkpoint
+    gJournal.close();
+
+    //Write the scripted run's report
+    gHarness.stop();
+
+    //Free the CPU renderer before its presenter goes away
+    gSoftRenderer.free();
+
+    //Detach the bot control region
+    pong_shm_close( gShm );
+    gShm = NULL;
+
     //Quit SDL subsystems
     TTF_Quit();
     IMG_Quit();
@@ -669,9 +1047,113 @@ void close()
 }
 
 
-int main()
+int main( int argc, char* args[] )
 {
-    srand (time(NULL));
+    //Scripted run options
+    const char* scriptPath = NULL;
+    const char* goldenDir = "";
+    const char* reportPath = "harness_report.json";
+    Uint32 seed = 1;
+
+    //Bot control options
+    const char* shmName = NULL;
+    Uint32 shmMode = PONG_SHM_FREE_RUNNING;
+
+    //Recording options
+    const char* capturePath = NULL;
+    const char* analyticsPath = NULL;
+    const char* checkpointPath = NULL;
+    CaptureFormat captureFormat = CAPTURE_Y4M;
+    for( int i = 1; i < argc; ++i )
+    {
+        string arg = args[ i ];
+        if( arg == "--shm" && i + 1 < argc )
+        {
+            shmName = args[ ++i ];
+        }
+        else if( arg == "--lockstep" )
+        {
+            shmMode = PONG_SHM_LOCKSTEP;
+        }
+        else if( arg == "--novsync" )
+        {
+            gVsync = false;
+        }
+        else if( arg == "--capture" && i + 1 < argc )
+        {
+            capturePath = args[ ++i ];
+        }
+        else if( arg == "--capture-rgba" )
+        {
+            captureFormat = CAPTURE_RGBA;
+        }
+        else if( arg == "--analytics" && i + 1 < argc )
+        {
+            analyticsPath = args[ ++i ];
+        }
+        else if( arg == "--checkpoint" && i + 1 < argc )
+        {
+            checkpointPath = args[ ++i ];
+        }
+        else if( arg == "--script" && i + 1 < argc )
+        {
+            scriptPath = args[ ++i ];
+        }
+        else if( arg == "--seed" && i + 1 < argc )
+        {
+            seed = (Uint32)strtoul( args[ ++i ], NULL, 10 );
+        }
+        else if( arg == "--golden" && i + 1 < argc )
+        {
+            goldenDir = args[ ++i ];
+        }
+        else if( arg == "--report" && i + 1 < argc )
+        {
+            reportPath = args[ ++i ];
+        }
+        else if( arg == "--cpu-render" )
+        {
+            gSoftware = true;
+        }
+        else if( arg == "--cpu-threads" && i + 1 < argc )
+        {
+            gSoftThreads = atoi( args[ ++i ] );
+        }
+        else
+        {
+            printf( "Usage: %s [--shm name] [--lockstep] [--novsync] [--capture file|'|command'] [--capture-rgba] [--cpu-render] [--cpu-threads n] [--analytics file] [--checkpoint file] [--script file] [--seed n] [--golden dir] [--report file]\n", args[ 0 ] );
+            return 1;
+        }
+    }
+
+    if( scriptPath != NULL )
+    {
+        if( !gHarness.start( scriptPath, goldenDir, reportPath, seed ) )
+        {
+            printf( "Failed to load input script!\n" );
+            return 1;
+        }
+
+        //Same serves every run, no window, no sound card and no waiting on vsync
+        srand( seed );
+        SDL_setenv( "SDL_VIDEODRIVER", "dummy", 1 );
+        SDL_setenv( "SDL_AUDIODRIVER", "dummy", 1 );
+        gVsync = false;
+    }
+    else
+    {
+        srand (time(NULL));
+    }
+
+    if( shmName != NULL )
+    {
+        gShm = pong_shm_create( shmName, shmMode );
+        if( gShm == NULL )
+        {
+            printf( "Failed to create bot control region!\n" );
+            return 1;
+        }
+    }
 
     //Start up SDL and create window
     if( !init() )
@@ -685,6 +1167,18 @@ int main()
         {
             printf( "Failed to load media!\n" );
         }
+        else if( capturePath != NULL && !gCapture.start( capturePath, captureFormat, SCREEN_WIDTH, SCREEN_HEIGHT, 60 ) )
+        {
+            printf( "Failed to start capture!\n" );
+        }
+        else if( analyticsPath != NULL && !gAnalytics.start( analyticsPath ) )
+        {
+            printf( "Failed to start match analytics!\n" );
+        }
+        else if( checkpointPath != NULL && !gJournal.open( checkpointPath, sizeof( Match ), 1, CHECKPOINT_CAPACITY, MATCH_COMPARE_SIZE ) )
+        {
+            printf( "Failed to open checkpoint journal!\n" );
+        }
         else
         {
             //Main loop flag
@@ -693,8 +1187,18 @@ int main()
             //Event handler
             SDL_Event e;
 
-            Paddle paddle;
-            Ball ball;
+            //The match being played
+            Match match;
+            Paddle& paddle = match.paddle;
+            Ball& ball = match.ball;
+
+            //Pick up where the last run left off
+            if( gJournal.isOpen() && gJournal.restore( &match ) > 0 )
+            {
+                //The checkpoint also holds whatever was steering the paddles then
+                paddle.releaseInput();
+                printf( "Resumed match at tick %u, %d - %d\n", (unsigned)match.tick, match.player1_score, match.player2_score );
+            }
 
             //While application is running
             while( !quit )
@@ -703,6 +1207,12 @@ int main()
                 start_time = SDL_GetTicks();
                 float delta = (start_time - end_time) / 1000.0f;
 
+                //Queue the script's input for this frame
+                if( gHarness.isActive() )
+                {
+                    gHarness.beginFrame();
+                }
+
                 //Handle events on queue
                 while( SDL_PollEvent( &e ) != 0 )
                 {
@@ -723,8 +1233,17 @@ int main()
                     paddle.handleEvent( e );
                     ball.startEvent( e );
                 }
+
+                //Input from the bot
+                if( gShm != NULL )
+                {
+                    exchangeWithBot( match );
+                }
                 //Move ball
-                ball.moveBall();
+                if( ball.moveBall() )
+                {
+                    logMatchEvent( match, EVENT_WALL_BOUNCE, 0, 0 );
+                }
 
 
                 //Move the paddles
@@ -732,6 +1251,12 @@ int main()
 
                 if(checkCollision(ball.cBall, paddle.pad_P1) == true )
                 {
+                    //Count the hit once, not every frame of the overlap
+                    if( ball.BallXVel != ball.BALL_SPEED )
+                    {
+                        match.rallyLength++;
+                        logMatchEvent( match, EVENT_PADDLE_HIT, 1, ( ball.cBall.y + ball.BALL_HEIGHT / 2 ) - ( paddle.pad_P1.y + paddle.PADDLE_HEIGHT / 2 ) );
+                    }
                     ball.BallXVel = ball.BALL_SPEED; //1 * ball.BallXVel; //rand() % 25;
                     //ball.BallYVel = Ball_angle(paddle.pad_P1.y, ball.cBall.y); //-1 * ball.BallYVel;
                     Mix_PlayChannel( -1, gPaddle, 0 );
@@ -739,6 +1264,12 @@ int main()
 
                 if(checkCollision(ball.cBall, paddle.pad_P2) == true )
                 {
+                    //Count the hit once, not every frame of the overlap
+                    if( ball.BallXVel != -ball.BALL_SPEED )
+                    {
+                        match.rallyLength++;
+                        logMatchEvent( match, EVENT_PADDLE_HIT, 2, ( ball.cBall.y + ball.BALL_HEIGHT / 2 ) - ( paddle.pad_P2.y + paddle.PADDLE_HEIGHT / 2 ) );
+                    }
                     ball.BallXVel = -ball.BALL_SPEED; //1 * ball.BallXVel; //(rand() % 25) * -1;
                     //ball.BallYVel = Ball_angle(paddle.pad_P2.y, ball.cBall.y); // -1 * ball.BallYVel;
                     Mix_PlayChannel( -1, gPaddle, 0 );
@@ -749,24 +1280,35 @@ int main()
                 //if player 2 scores
                 if( ( ball.cBall.x + ball.BALL_WIDTH ) < 0 )
                 {
-                    player2_score++;
-                    p2_scored = true;
+                    match.player2_score++;
+                    match.p2_scored = true;
                     Mix_PlayChannel( -1, gMiss, 0 );
+                    logMatchEvent( match, EVENT_POINT, 2, 0 );
+                    match.rallyLength = 0;
                     ball.reset();
                 }
 
                 //if player 1 scores
                 if ( ball.cBall.x > SCREEN_WIDTH  )
                 {
-                    player1_score++;
-                    p1_scored = true;
+                    match.player1_score++;
+                    match.p1_scored = true;
                     Mix_PlayChannel( -1, gMiss, 0 );
+                    logMatchEvent( match, EVENT_POINT, 1, 0 );
+                    match.rallyLength = 0;
                     ball.reset();
                 }
 
                 //Clear screen
-                SDL_SetRenderDrawColor( gRenderer, 0x00, 0x00, 0x00, 0x00 );
-                SDL_RenderClear( gRenderer );
+                if( gSoftware )
+                {
+                    gSoftRenderer.clear( 0x00, 0x00, 0x00 );
+                }
+                else
+                {
+                    SDL_SetRenderDrawColor( gRenderer, 0x00, 0x00, 0x00, 0x00 );
+                    SDL_RenderClear( gRenderer );
+                }
 
                 //Render background texture to screen
                 gBackgroundTexture.render( 0, 0 );
@@ -775,16 +1317,60 @@ int main()
                 SDL_SetRenderDrawColor( gRenderer, 0xFF, 0xFF, 0xFF, 0xFF );
                 for( int i = 0; i < SCREEN_HEIGHT; i += 4 )
                 {
-                    SDL_RenderDrawPoint( gRenderer, SCREEN_WIDTH / 2, i );
+                    if( gSoftware )
+                    {
+                        SDL_Rect dot = { SCREEN_WIDTH / 2, i, 1, 1 };
+                        gSoftRenderer.fillRect( dot, 0xFF, 0xFF, 0xFF );
+                    }
+                    else
+                    {
+                        SDL_RenderDrawPoint( gRenderer, SCREEN_WIDTH / 2, i );
+                    }
                 }
 
                 paddle.render1();
                 paddle.render2();
                 ball.render();
 
+                //Rasterize and hand the frame to SDL
+                if( gSoftware )
+                {
+                    gSoftRenderer.flush();
+                }
+
+                //Check the frame against the golden image if the script asks
+                if( gHarness.isActive() )
+                {
+                    gHarness.checkFrame( gRenderer, SCREEN_WIDTH, SCREEN_HEIGHT );
+                }
+
+                //Record the frame before it is presented
+                if( gCapture.isActive() )
+                {
+                    gCapture.captureFrame( gRenderer );
+                    if( gCapture.getCaptured() % CAPTURE_REPORT_FRAMES == 0 )
+                    {
+                        printf( "Capture: %.3f ms per frame, %u skipped, %u dropped\n", gCapture.getAverageOverhead(), gCapture.getSkipped(), gCapture.getDropped() );
+                    }
+                }
+
                 //Update screen
                 SDL_RenderPresent( gRenderer );
 
+                match.tick++;
+
+                //Save the match if anything but the tick moved, one slice of
+                //the matches per tick
+                if( gJournal.isOpen() )
+                {
+                    gJournal.checkpoint( &match, match.tick % CHECKPOINT_TICKS, CHECKPOINT_TICKS );
+                }
+
+                //Stop when the script runs out
+                if( gHarness.isActive() && !gHarness.endFrame() )
+                {
+                    quit = true;
+                }
             }
         }
     }
@@ -0,0 +1,255 @@
+/*
+Shared-memory control interface, mapping the region on Windows and POSIX.
+*/
+
+//ftruncate and kill aren't declared in strict C99 without it
+#define _POSIX_C_SOURCE 200809L
+
+#include "pong_shm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+struct PongShm
+{
+    PongShmRegion* region;
+
+    //Only the creator removes the name on close
+    int owner;
+
+    //Platform object name
+    char name[ 128 ];
+
+#ifdef _WIN32
+    HANDLE mapping;
+#endif
+};
+
+//Builds the platform object name from the user supplied one
+static void pong_shm_make_name( char* out, size_t size, const char* name )
+{
+#ifdef _WIN32
+    snprintf( out, size, "Local\\pong_%s", name );
+#else
+    snprintf( out, size, "/pong_%s", name );
+#endif
+}
+
+#ifndef _WIN32
+//Checks if an existing region was left by a game that is no longer running.
+//Anything that can't be read as a Pong control region counts as live
+static int pong_shm_is_stale( const char* name )
+{
+    int fd = shm_open( name, O_RDONLY, 0600 );
+    if( fd < 0 )
+    {
+        return errno == ENOENT;
+    }
+
+    int stale = 0;
+    struct stat info;
+    if( fstat( fd, &info ) == 0 && info.st_size >= (off_t)sizeof( PongShmRegion ) )
+    {
+        void* region = mmap( NULL, sizeof( PongShmRegion ), PROT_READ, MAP_SHARED, fd, 0 );
+        if( region != MAP_FAILED )
+        {
+            const PongShmRegion* old = (const PongShmRegion*)region;
+            if( __atomic_load_n( &old->magic, __ATOMIC_ACQUIRE ) == PONG_SHM_MAGIC && old->game_pid != 0 )
+            {
+                stale = kill( (pid_t)old->game_pid, 0 ) != 0 && errno == ESRCH;
+            }
+            munmap( region, sizeof( PongShmRegion ) );
+        }
+    }
+    close( fd );
+    return stale;
+}
+#endif
+
+//Maps the region, creating it when create is set
+static PongShm* pong_shm_map( const char* name, int create )
+{
+    PongShm* shm = (PongShm*)calloc( 1, sizeof( PongShm ) );
+    if( shm == NULL )
+    {
+        return NULL;
+    }
+
+    pong_shm_make_name( shm->name, sizeof( shm->name ), name );
+    shm->owner = create;
+
+#ifdef _WIN32
+    if( create )
+    {
+        shm->mapping = CreateFileMappingA( INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof( PongShmRegion ), shm->name );
+    }
+    else
+    {
+        shm->mapping = OpenFileMappingA( FILE_MAP_ALL_ACCESS, FALSE, shm->name );
+    }
+
+    if( shm->mapping == NULL )
+    {
+        printf( "Unable to map shared memory %s! Error: %lu\n", shm->name, GetLastError() );
+        free( shm );
+        return NULL;
+    }
+
+    //The name only outlives its last handle, so someone is still using it
+    if( create && GetLastError() == ERROR_ALREADY_EXISTS )
+    {
+        printf( "Shared memory %s is already in use by another game!\n", shm->name );
+        CloseHandle( shm->mapping );
+        free( shm );
+        return NULL;
+    }
+
+    shm->region = (PongShmRegion*)MapViewOfFile( shm->mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof( PongShmRegion ) );
+    if( shm->region == NULL )
+    {
+        printf( "Unable to map shared memory %s! Error: %lu\n", shm->name, GetLastError() );
+        CloseHandle( shm->mapping );
+        free( shm );
+        return NULL;
+    }
+#else
+    //Never take over a region another game is still running on
+    int flags = create ? ( O_CREAT | O_EXCL | O_RDWR ) : O_RDWR;
+    int fd = shm_open( shm->name, flags, 0600 );
+    if( fd < 0 && create && errno == EEXIST && pong_shm_is_stale( shm->name ) )
+    {
+        printf( "Removing shared memory %s left by a game that is no longer running\n", shm->name );
+        shm_unlink( shm->name );
+        fd = shm_open( shm->name, flags, 0600 );
+    }
+
+    if( fd < 0 )
+    {
+        if( create && errno == EEXIST )
+        {
+            printf( "Shared memory %s is already in use by another game! Remove /dev/shm%s if it isn't\n", shm->name, shm->name );
+        }
+        else
+        {
+            perror( "Unable to open shared memory" );
+        }
+        free( shm );
+        return NULL;
+    }
+
+    if( create && ftruncate( fd, sizeof( PongShmRegion ) ) != 0 )
+    {
+        perror( "Unable to size shared memory" );
+        close( fd );
+        shm_unlink( shm->name );
+        free( shm );
+        return NULL;
+    }
+
+    void* region = mmap( NULL, sizeof( PongShmRegion ), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    close( fd );
+    if( region == MAP_FAILED )
+    {
+        perror( "Unable to map shared memory" );
+        if( create )
+        {
+            shm_unlink( shm->name );
+        }
+        free( shm );
+        return NULL;
+    }
+    shm->region = (PongShmRegion*)region;
+#endif
+
+    return shm;
+}
+
+PongShm* pong_shm_create( const char* name, uint32_t mode )
+{
+    PongShm* shm = pong_shm_map( name, 1 );
+    if( shm == NULL )
+    {
+        return NULL;
+    }
+
+    //Start from empty rings, then publish the header last
+    memset( shm->region, 0, sizeof( PongShmRegion ) );
+    shm->region->version = PONG_SHM_VERSION;
+    shm->region->mode = mode;
+#ifdef _WIN32
+    shm->region->game_pid = (uint32_t)GetCurrentProcessId();
+#else
+    shm->region->game_pid = (uint32_t)getpid();
+#endif
+    pong_shm_set_flag( &shm->region->game_attached, 1 );
+    __atomic_store_n( &shm->region->magic, PONG_SHM_MAGIC, __ATOMIC_RELEASE );
+
+    return shm;
+}
+
+PongShm* pong_shm_open( const char* name )
+{
+    PongShm* shm = pong_shm_map( name, 0 );
+    if( shm == NULL )
+    {
+        return NULL;
+    }
+
+    if( __atomic_load_n( &shm->region->magic, __ATOMIC_ACQUIRE ) != PONG_SHM_MAGIC || shm->region->version != PONG_SHM_VERSION )
+    {
+        printf( "Shared memory %s is not a Pong control region!\n", shm->name );
+        pong_shm_close( shm );
+        return NULL;
+    }
+
+    pong_shm_set_flag( &shm->region->bot_attached, 1 );
+    return shm;
+}
+
+void pong_shm_close( PongShm* shm )
+{
+    if( shm == NULL )
+    {
+        return;
+    }
+
+    //Let the other side know we're gone
+    if( shm->owner )
+    {
+        pong_shm_set_flag( &shm->region->game_attached, 0 );
+    }
+    else if( shm->region->magic == PONG_SHM_MAGIC )
+    {
+        pong_shm_set_flag( &shm->region->bot_attached, 0 );
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile( shm->region );
+    CloseHandle( shm->mapping );
+#else
+    munmap( shm->region, sizeof( PongShmRegion ) );
+    if( shm->owner )
+    {
+        shm_unlink( shm->name );
+    }
+#endif
+
+    free( shm );
+}
+
+PongShmRegion* pong_shm_region( PongShm* shm )
+{
+    return shm->region;
+}
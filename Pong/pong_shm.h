@@ -0,0 +1,213 @@
+/*
+Shared-memory control interface for external bot processes.
+
+The game creates a named region holding two lock-free single-producer /
+single-consumer rings: the game publishes a PongState every tick and the bot
+answers with PongCommands that stand in for the W/S and UP/DOWN key events.
+
+This header is plain C so bots can include it without the rest of the game.
+*/
+
+#ifndef PONG_SHM_H
+#define PONG_SHM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Region identification
+#define PONG_SHM_MAGIC 0x474E4F50u /* "PONG" */
+#define PONG_SHM_VERSION 1
+
+//Slots per ring, must be a power of two
+#define PONG_SHM_RING_SLOTS 64
+
+//Keeps the producer and consumer indices on separate cache lines
+#define PONG_SHM_CACHE_LINE 64
+
+//Run modes
+#define PONG_SHM_FREE_RUNNING 0
+#define PONG_SHM_LOCKSTEP 1
+
+//Command flags
+#define PONG_CMD_P1 0x01    /* p1_dir is valid, bot drives the left paddle */
+#define PONG_CMD_P2 0x02    /* p2_dir is valid, bot drives the right paddle */
+#define PONG_CMD_SERVE 0x04 /* same as pressing space */
+
+//Game state published once per tick
+typedef struct PongState
+{
+    uint32_t tick;
+    int32_t ball_x, ball_y;
+    int32_t ball_vx, ball_vy;
+    int32_t p1_y, p1_vy;
+    int32_t p2_y, p2_vy;
+    int32_t p1_score, p2_score;
+} PongState;
+
+//Paddle command sent by the bot
+typedef struct PongCommand
+{
+    //Tick of the state this command answers (used in lockstep mode)
+    uint32_t tick;
+
+    //-1 moves up, 0 stops, 1 moves down
+    int8_t p1_dir;
+    int8_t p2_dir;
+
+    //PONG_CMD_* flags
+    uint8_t flags;
+    uint8_t reserved;
+} PongCommand;
+
+typedef struct PongStateRing
+{
+    volatile uint32_t head;
+    char pad0[ PONG_SHM_CACHE_LINE - sizeof( uint32_t ) ];
+    volatile uint32_t tail;
+    char pad1[ PONG_SHM_CACHE_LINE - sizeof( uint32_t ) ];
+    PongState slots[ PONG_SHM_RING_SLOTS ];
+} PongStateRing;
+
+typedef struct PongCommandRing
+{
+    volatile uint32_t head;
+    char pad0[ PONG_SHM_CACHE_LINE - sizeof( uint32_t ) ];
+    volatile uint32_t tail;
+    char pad1[ PONG_SHM_CACHE_LINE - sizeof( uint32_t ) ];
+    PongCommand slots[ PONG_SHM_RING_SLOTS ];
+} PongCommandRing;
+
+//Layout of the mapped region
+typedef struct PongShmRegion
+{
+    uint32_t magic;
+    uint32_t version;
+
+    //PONG_SHM_FREE_RUNNING or PONG_SHM_LOCKSTEP
+    uint32_t mode;
+
+    //Set while each side has the region mapped
+    volatile uint32_t game_attached;
+    volatile uint32_t bot_attached;
+
+    //States the game could not publish because the bot fell behind
+    volatile uint32_t dropped_states;
+
+    //Process id of the game, tells a crashed game's region from a live one
+    uint32_t game_pid;
+
+    char pad[ PONG_SHM_CACHE_LINE - 7 * sizeof( uint32_t ) ];
+
+    //Game -> bot
+    PongStateRing state;
+
+    //Bot -> game
+    PongCommandRing command;
+} PongShmRegion;
+
+//Mapped region plus the platform handle that owns it
+typedef struct PongShm PongShm;
+
+//Creates and initializes the region (game side). Fails if another game
+//already has the name, a region left by a game that is gone is replaced
+PongShm* pong_shm_create( const char* name, uint32_t mode );
+
+//Maps an existing region (bot side)
+PongShm* pong_shm_open( const char* name );
+
+//Unmaps the region, the creator also removes the name
+void pong_shm_close( PongShm* shm );
+
+//Gets the mapped region
+PongShmRegion* pong_shm_region( PongShm* shm );
+
+//Attached flag helpers
+static inline void pong_shm_set_flag( volatile uint32_t* flag, uint32_t value )
+{
+    __atomic_store_n( flag, value, __ATOMIC_RELEASE );
+}
+
+static inline uint32_t pong_shm_get_flag( const volatile uint32_t* flag )
+{
+    return __atomic_load_n( flag, __ATOMIC_ACQUIRE );
+}
+
+//Publishes a state, returns 0 if the ring is full
+static inline int pong_shm_push_state( PongShmRegion* r, const PongState* s )
+{
+    uint32_t head = __atomic_load_n( &r->state.head, __ATOMIC_RELAXED );
+    uint32_t tail = __atomic_load_n( &r->state.tail, __ATOMIC_ACQUIRE );
+    if( head - tail == PONG_SHM_RING_SLOTS )
+    {
+        return 0;
+    }
+
+    r->state.slots[ head & ( PONG_SHM_RING_SLOTS - 1 ) ] = *s;
+    __atomic_store_n( &r->state.head, head + 1, __ATOMIC_RELEASE );
+    return 1;
+}
+
+//Takes the oldest state, returns 0 if the ring is empty
+static inline int pong_shm_pop_state( PongShmRegion* r, PongState* s )
+{
+    uint32_t tail = __atomic_load_n( &r->state.tail, __ATOMIC_RELAXED );
+    uint32_t head = __atomic_load_n( &r->state.head, __ATOMIC_ACQUIRE );
+    if( head == tail )
+    {
+        return 0;
+    }
+
+    *s = r->state.slots[ tail & ( PONG_SHM_RING_SLOTS - 1 ) ];
+    __atomic_store_n( &r->state.tail, tail + 1, __ATOMIC_RELEASE );
+    return 1;
+}
+
+//Drains the ring keeping only the newest state, returns 0 if it was empty
+static inline int pong_shm_latest_state( PongShmRegion* r, PongState* s )
+{
+    int found = 0;
+    while( pong_shm_pop_state( r, s ) )
+    {
+        found = 1;
+    }
+    return found;
+}
+
+//Sends a command, returns 0 if the ring is full
+static inline int pong_shm_push_command( PongShmRegion* r, const PongCommand* c )
+{
+    uint32_t head = __atomic_load_n( &r->command.head, __ATOMIC_RELAXED );
+    uint32_t tail = __atomic_load_n( &r->command.tail, __ATOMIC_ACQUIRE );
+    if( head - tail == PONG_SHM_RING_SLOTS )
+    {
+        return 0;
+    }
+
+    r->command.slots[ head & ( PONG_SHM_RING_SLOTS - 1 ) ] = *c;
+    __atomic_store_n( &r->command.head, head + 1, __ATOMIC_RELEASE );
+    return 1;
+}
+
+//Takes the oldest command, returns 0 if the ring is empty
+static inline int pong_shm_pop_command( PongShmRegion* r, PongCommand* c )
+{
+    uint32_t tail = __atomic_load_n( &r->command.tail, __ATOMIC_RELAXED );
+    uint32_t head = __atomic_load_n( &r->command.head, __ATOMIC_ACQUIRE );
+    if( head == tail )
+    {
+        return 0;
+    }
+
+    *c = r->command.slots[ tail & ( PONG_SHM_RING_SLOTS - 1 ) ];
+    __atomic_store_n( &r->command.tail, tail + 1, __ATOMIC_RELEASE );
+    return 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,674 @@
+/*
+CPU render backend for machines without a GPU.
+*/
+
+#include "softrender.h"
+
+#include <SDL_thread.h>
+#include <stdio.h>
+#include <string.h>
+using namespace std;
+
+//SSE2 kernels are compiled on x86 with GCC and picked at runtime
+#if defined( __GNUC__ ) && ( defined( __i386__ ) || defined( __x86_64__ ) )
+#define SOFT_SSE2 1
+#include <emmintrin.h>
+#define SOFT_TARGET_SSE2 __attribute__(( target( "sse2" ) ))
+#endif
+
+//Set once at init when the CPU has SSE2
+static bool gSoftHasSSE2 = false;
+
+//Every load gets a new generation so reused addresses never look unchanged
+static Uint32 gSoftGeneration = 0;
+
+//Alpha channel of an ARGB8888 pixel
+static const Uint32 ALPHA_MASK = 0xFF000000;
+
+static void fillRowScalar( Uint32* dst, int count, Uint32 color )
+{
+    for( int i = 0; i < count; ++i )
+    {
+        dst[ i ] = color;
+    }
+}
+
+static void copyRowKeyedScalar( Uint32* dst, const Uint32* src, int count )
+{
+    for( int i = 0; i < count; ++i )
+    {
+        if( src[ i ] & ALPHA_MASK )
+        {
+            dst[ i ] = src[ i ];
+        }
+    }
+}
+
+#ifdef SOFT_SSE2
+SOFT_TARGET_SSE2 static void fillRowSSE2( Uint32* dst, int count, Uint32 color )
+{
+    __m128i c = _mm_set1_epi32( (int)color );
+    int i = 0;
+    for( ; i + 4 <= count; i += 4 )
+    {
+        _mm_storeu_si128( (__m128i*)( dst + i ), c );
+    }
+    fillRowScalar( dst + i, count - i, color );
+}
+
+SOFT_TARGET_SSE2 static void copyRowKeyedSSE2( Uint32* dst, const Uint32* src, int count )
+{
+    //Pixels with zero alpha keep the destination
+    __m128i alpha = _mm_set1_epi32( (int)ALPHA_MASK );
+    __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for( ; i + 4 <= count; i += 4 )
+    {
+        __m128i s = _mm_loadu_si128( (const __m128i*)( src + i ) );
+        __m128i d = _mm_loadu_si128( (const __m128i*)( dst + i ) );
+        __m128i keep = _mm_cmpeq_epi32( _mm_and_si128( s, alpha ), zero );
+        __m128i out = _mm_or_si128( _mm_and_si128( keep, d ), _mm_andnot_si128( keep, s ) );
+        _mm_storeu_si128( (__m128i*)( dst + i ), out );
+    }
+    copyRowKeyedScalar( dst + i, src + i, count - i );
+}
+#endif
+
+static void fillRow( Uint32* dst, int count, Uint32 color )
+{
+#ifdef SOFT_SSE2
+    if( gSoftHasSSE2 )
+    {
+        fillRowSSE2( dst, count, color );
+        return;
+    }
+#endif
+    fillRowScalar( dst, count, color );
+}
+
+static void copyRowKeyed( Uint32* dst, const Uint32* src, int count )
+{
+#ifdef SOFT_SSE2
+    if( gSoftHasSSE2 )
+    {
+        copyRowKeyedSSE2( dst, src, count );
+        return;
+    }
+#endif
+    copyRowKeyedScalar( dst, src, count );
+}
+
+//Divides a 0..255*255 product by 255
+static inline Uint32 div255( Uint32 x )
+{
+    x += 128;
+    return ( x + ( x >> 8 ) ) >> 8;
+}
+
+static void copyRowBlend( Uint32* dst, const Uint32* src, int count )
+{
+    for( int i = 0; i < count; ++i )
+    {
+        Uint32 s = src[ i ];
+        Uint32 a = s >> 24;
+        if( a == 0xFF )
+        {
+            dst[ i ] = s;
+        }
+        else if( a != 0 )
+        {
+            Uint32 d = dst[ i ];
+            Uint32 r = div255( ( ( s >> 16 ) & 0xFF ) * a + ( ( d >> 16 ) & 0xFF ) * ( 255 - a ) );
+            Uint32 g = div255( ( ( s >> 8 ) & 0xFF ) * a + ( ( d >> 8 ) & 0xFF ) * ( 255 - a ) );
+            Uint32 b = div255( ( s & 0xFF ) * a + ( d & 0xFF ) * ( 255 - a ) );
+            dst[ i ] = ALPHA_MASK | ( r << 16 ) | ( g << 8 ) | b;
+        }
+    }
+}
+
+//Checks if rect a covers all of rect b
+static bool covers( const SDL_Rect& a, const SDL_Rect& b )
+{
+    return a.x <= b.x && a.y <= b.y && a.x + a.w >= b.x + b.w && a.y + a.h >= b.y + b.h;
+}
+
+//Clips rect a against rect b, returns false if nothing is left
+static bool clipRect( const SDL_Rect& a, const SDL_Rect& b, SDL_Rect& out )
+{
+    int x1 = a.x > b.x ? a.x : b.x;
+    int y1 = a.y > b.y ? a.y : b.y;
+    int x2 = a.x + a.w < b.x + b.w ? a.x + a.w : b.x + b.w;
+    int y2 = a.y + a.h < b.y + b.h ? a.y + a.h : b.y + b.h;
+    if( x2 <= x1 || y2 <= y1 )
+    {
+        return false;
+    }
+
+    out.x = x1;
+    out.y = y1;
+    out.w = x2 - x1;
+    out.h = y2 - y1;
+    return true;
+}
+
+//FNV-1a over the bytes of a value
+static void hashBytes( Uint64& hash, const void* data, size_t size )
+{
+    const Uint8* bytes = (const Uint8*)data;
+    for( size_t i = 0; i < size; ++i )
+    {
+        hash ^= bytes[ i ];
+        hash *= 1099511628211ull;
+    }
+}
+
+SoftImage::SoftImage()
+{
+    //Initialize
+    mWidth = 0;
+    mHeight = 0;
+    mCoverage = COVERAGE_OPAQUE;
+    mGeneration = 0;
+}
+
+bool SoftImage::loadFromSurface( SDL_Surface* surface )
+{
+    //Convert without the key so it can be turned into alpha here
+    Uint32 key = 0;
+    bool keyed = SDL_GetColorKey( surface, &key ) == 0;
+    Uint32 keyRGB = 0;
+    if( keyed )
+    {
+        Uint8 r, g, b;
+        SDL_GetRGB( key, surface->format, &r, &g, &b );
+        keyRGB = ( r << 16 ) | ( g << 8 ) | b;
+        SDL_SetColorKey( surface, SDL_FALSE, key );
+    }
+
+    SDL_Surface* converted = SDL_ConvertSurfaceFormat( surface, SDL_PIXELFORMAT_ARGB8888, 0 );
+
+    if( keyed )
+    {
+        SDL_SetColorKey( surface, SDL_TRUE, key );
+    }
+
+    if( converted == NULL )
+    {
+        printf( "Unable to convert surface for software rendering! SDL Error: %s\n", SDL_GetError() );
+        return false;
+    }
+
+    mWidth = converted->w;
+    mHeight = converted->h;
+    mOriginal.resize( mWidth * mHeight );
+
+    SDL_LockSurface( converted );
+    for( int y = 0; y < mHeight; ++y )
+    {
+        const Uint32* row = (const Uint32*)( (const Uint8*)converted->pixels + y * converted->pitch );
+        Uint32* out = &mOriginal[ y * mWidth ];
+        for( int x = 0; x < mWidth; ++x )
+        {
+            out[ x ] = keyed && ( row[ x ] & ~ALPHA_MASK ) == keyRGB ? 0 : row[ x ];
+        }
+    }
+    SDL_UnlockSurface( converted );
+    SDL_FreeSurface( converted );
+
+    mPixels = mOriginal;
+    classify();
+    mGeneration = ++gSoftGeneration;
+
+    return true;
+}
+
+void SoftImage::setColor( Uint8 red, Uint8 green, Uint8 blue )
+{
+    //Bake the modulation into the pixels
+    for( size_t i = 0; i < mOriginal.size(); ++i )
+    {
+        Uint32 p = mOriginal[ i ];
+        Uint32 r = div255( ( ( p >> 16 ) & 0xFF ) * red );
+        Uint32 g = div255( ( ( p >> 8 ) & 0xFF ) * green );
+        Uint32 b = div255( ( p & 0xFF ) * blue );
+        mPixels[ i ] = ( p & ALPHA_MASK ) | ( r << 16 ) | ( g << 8 ) | b;
+    }
+    mGeneration = ++gSoftGeneration;
+}
+
+int SoftImage::getWidth() const
+{
+    return mWidth;
+}
+
+int SoftImage::getHeight() const
+{
+    return mHeight;
+}
+
+const Uint32* SoftImage::getPixels() const
+{
+    return mPixels.empty() ? NULL : &mPixels[ 0 ];
+}
+
+SoftImage::Coverage SoftImage::getCoverage() const
+{
+    return mCoverage;
+}
+
+Uint32 SoftImage::getGeneration() const
+{
+    return mGeneration;
+}
+
+void SoftImage::classify()
+{
+    mCoverage = COVERAGE_OPAQUE;
+    for( size_t i = 0; i < mPixels.size(); ++i )
+    {
+        Uint32 a = mPixels[ i ] >> 24;
+        if( a != 0xFF )
+        {
+            if( a != 0 )
+            {
+                mCoverage = COVERAGE_TRANSLUCENT;
+                return;
+            }
+            mCoverage = COVERAGE_KEYED;
+        }
+    }
+}
+
+SoftRenderer::SoftRenderer()
+{
+    //Initialize
+    mWidth = 0;
+    mHeight = 0;
+    mTilesX = 0;
+    mTilesY = 0;
+    mPresenter = NULL;
+    mTexture = NULL;
+    mMutex = NULL;
+    mStartCond = NULL;
+    mDoneCond = NULL;
+    mFrame = 0;
+    mBusyWorkers = 0;
+    mFirstFrame = 0;
+    mQuit = false;
+    mNextTile = 0;
+    mDirtyTiles = 0;
+}
+
+SoftRenderer::~SoftRenderer()
+{
+    //Deallocate
+    free();
+}
+
+bool SoftRenderer::init( SDL_Renderer* presenter, int width, int height, int threads )
+{
+    //Get rid of a previous framebuffer
+    free();
+
+    gSoftHasSSE2 = SDL_HasSSE2() == SDL_TRUE;
+
+    mPresenter = presenter;
+    mTexture = SDL_CreateTexture( mPresenter, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, width, height );
+    if( mTexture == NULL )
+    {
+        printf( "Unable to create streaming texture! SDL Error: %s\n", SDL_GetError() );
+        return false;
+    }
+
+    mWidth = width;
+    mHeight = height;
+    mFramebuffer.assign( mWidth * mHeight, ALPHA_MASK );
+
+    mTilesX = ( mWidth + TILE_WIDTH - 1 ) / TILE_WIDTH;
+    mTilesY = ( mHeight + TILE_HEIGHT - 1 ) / TILE_HEIGHT;
+    mBins.assign( mTilesX * mTilesY, vector<int>() );
+    mDirty.assign( mTilesX * mTilesY, 0 );
+
+    //Hashes are never zero, so every tile draws on the first frame
+    mTileHashes.assign( mTilesX * mTilesY, 0 );
+
+    mMutex = SDL_CreateMutex();
+    mStartCond = SDL_CreateCond();
+    mDoneCond = SDL_CreateCond();
+    if( mMutex == NULL || mStartCond == NULL || mDoneCond == NULL )
+    {
+        printf( "Unable to create render workers! SDL Error: %s\n", SDL_GetError() );
+        free();
+        return false;
+    }
+
+    //The calling thread draws tiles too
+    if( threads <= 0 )
+    {
+        threads = SDL_GetCPUCount();
+    }
+    mQuit = false;
+    mFirstFrame = mFrame;
+    for( int i = 1; i < threads; ++i )
+    {
+        SDL_Thread* worker = SDL_CreateThread( workerThread, "SoftRenderer", this );
+        if( worker == NULL )
+        {
+            printf( "Unable to start render worker! SDL Error: %s\n", SDL_GetError() );
+            break;
+        }
+        mWorkers.push_back( worker );
+    }
+
+    return true;
+}
+
+void SoftRenderer::free()
+{
+    //Stop the workers
+    if( mMutex != NULL )
+    {
+        SDL_LockMutex( mMutex );
+        mQuit = true;
+        SDL_CondBroadcast( mStartCond );
+        SDL_UnlockMutex( mMutex );
+    }
+    for( size_t i = 0; i < mWorkers.size(); ++i )
+    {
+        SDL_WaitThread( mWorkers[ i ], NULL );
+    }
+    mWorkers.clear();
+
+    if( mStartCond != NULL )
+    {
+        SDL_DestroyCond( mStartCond );
+        mStartCond = NULL;
+    }
+    if( mDoneCond != NULL )
+    {
+        SDL_DestroyCond( mDoneCond );
+        mDoneCond = NULL;
+    }
+    if( mMutex != NULL )
+    {
+        SDL_DestroyMutex( mMutex );
+        mMutex = NULL;
+    }
+
+    if( mTexture != NULL )
+    {
+        SDL_DestroyTexture( mTexture );
+        mTexture = NULL;
+    }
+
+    mCommands.clear();
+    mBins.clear();
+    mTileHashes.clear();
+    mDirty.clear();
+    mFramebuffer.clear();
+    mWidth = 0;
+    mHeight = 0;
+    mTilesX = 0;
+    mTilesY = 0;
+}
+
+void SoftRenderer::clear( Uint8 red, Uint8 green, Uint8 blue )
+{
+    SDL_Rect screen = { 0, 0, mWidth, mHeight };
+    fillRect( screen, red, green, blue );
+}
+
+void SoftRenderer::fillRect( const SDL_Rect& rect, Uint8 red, Uint8 green, Uint8 blue )
+{
+    Command command;
+    command.type = Command::FILL;
+    command.dst = rect;
+    command.srcX = 0;
+    command.srcY = 0;
+    command.image = NULL;
+    command.color = ALPHA_MASK | ( red << 16 ) | ( green << 8 ) | blue;
+    command.generation = 0;
+    mCommands.push_back( command );
+}
+
+void SoftRenderer::blit( const SoftImage* image, int x, int y, const SDL_Rect* clip )
+{
+    //Same rules as SDL_RenderCopy with an unscaled quad
+    SDL_Rect source = { 0, 0, image->getWidth(), image->getHeight() };
+    if( clip != NULL && !clipRect( *clip, source, source ) )
+    {
+        return;
+    }
+
+    Command command;
+    command.type = Command::BLIT;
+    command.dst.x = x;
+    command.dst.y = y;
+    command.dst.w = source.w;
+    command.dst.h = source.h;
+    command.srcX = source.x;
+    command.srcY = source.y;
+    command.image = image;
+    command.color = 0;
+    command.generation = image->getGeneration();
+    mCommands.push_back( command );
+}
+
+void SoftRenderer::flush()
+{
+    //Bin every command into the tiles it touches
+    for( size_t i = 0; i < mBins.size(); ++i )
+    {
+        mBins[ i ].clear();
+    }
+
+    SDL_Rect screen = { 0, 0, mWidth, mHeight };
+    for( size_t i = 0; i < mCommands.size(); ++i )
+    {
+        SDL_Rect area;
+        if( !clipRect( mCommands[ i ].dst, screen, area ) )
+        {
+            continue;
+        }
+
+        int firstX = area.x / TILE_WIDTH, lastX = ( area.x + area.w - 1 ) / TILE_WIDTH;
+        int firstY = area.y / TILE_HEIGHT, lastY = ( area.y + area.h - 1 ) / TILE_HEIGHT;
+        for( int ty = firstY; ty <= lastY; ++ty )
+        {
+            for( int tx = firstX; tx <= lastX; ++tx )
+            {
+                mBins[ ty * mTilesX + tx ].push_back( (int)i );
+            }
+        }
+    }
+
+    //Wake the workers and draw alongside them
+    mNextTile = 0;
+    SDL_LockMutex( mMutex );
+    mFrame++;
+    mBusyWorkers = (int)mWorkers.size();
+    SDL_CondBroadcast( mStartCond );
+    SDL_UnlockMutex( mMutex );
+
+    drawTiles();
+
+    SDL_LockMutex( mMutex );
+    while( mBusyWorkers > 0 )
+    {
+        SDL_CondWait( mDoneCond, mMutex );
+    }
+    SDL_UnlockMutex( mMutex );
+
+    //Upload only the rows and columns that changed
+    int minX = mTilesX, minY = mTilesY, maxX = -1, maxY = -1;
+    mDirtyTiles = 0;
+    for( int ty = 0; ty < mTilesY; ++ty )
+    {
+        for( int tx = 0; tx < mTilesX; ++tx )
+        {
+            if( mDirty[ ty * mTilesX + tx ] )
+            {
+                mDirtyTiles++;
+                minX = tx < minX ? tx : minX;
+                maxX = tx > maxX ? tx : maxX;
+                minY = ty < minY ? ty : minY;
+                maxY = ty > maxY ? ty : maxY;
+            }
+        }
+    }
+
+    if( mDirtyTiles > 0 )
+    {
+        SDL_Rect upload;
+        upload.x = minX * TILE_WIDTH;
+        upload.y = minY * TILE_HEIGHT;
+        upload.w = ( maxX + 1 ) * TILE_WIDTH > mWidth ? mWidth - upload.x : ( maxX + 1 - minX ) * TILE_WIDTH;
+        upload.h = ( maxY + 1 ) * TILE_HEIGHT > mHeight ? mHeight - upload.y : ( maxY + 1 - minY ) * TILE_HEIGHT;
+        SDL_UpdateTexture( mTexture, &upload, &mFramebuffer[ upload.y * mWidth + upload.x ], mWidth * 4 );
+    }
+
+    //The texture covers the whole target so there is nothing to clear
+    SDL_RenderCopy( mPresenter, mTexture, NULL, NULL );
+
+    mCommands.clear();
+}
+
+const Uint32* SoftRenderer::getPixels() const
+{
+    return mFramebuffer.empty() ? NULL : &mFramebuffer[ 0 ];
+}
+
+int SoftRenderer::getWidth() const
+{
+    return mWidth;
+}
+
+int SoftRenderer::getHeight() const
+{
+    return mHeight;
+}
+
+int SoftRenderer::getDirtyTiles() const
+{
+    return mDirtyTiles;
+}
+
+int SoftRenderer::workerThread( void* data )
+{
+    SoftRenderer* renderer = (SoftRenderer*)data;
+
+    SDL_LockMutex( renderer->mMutex );
+    Uint32 frame = renderer->mFirstFrame;
+    for( ;; )
+    {
+        //Sleep until the next frame is binned
+        while( !renderer->mQuit && renderer->mFrame == frame )
+        {
+            SDL_CondWait( renderer->mStartCond, renderer->mMutex );
+        }
+        if( renderer->mQuit )
+        {
+            break;
+        }
+        frame = renderer->mFrame;
+        SDL_UnlockMutex( renderer->mMutex );
+
+        renderer->drawTiles();
+
+        SDL_LockMutex( renderer->mMutex );
+        if( --renderer->mBusyWorkers == 0 )
+        {
+            SDL_CondSignal( renderer->mDoneCond );
+        }
+    }
+    SDL_UnlockMutex( renderer->mMutex );
+
+    return 0;
+}
+
+void SoftRenderer::drawTiles()
+{
+    int tileCount = mTilesX * mTilesY;
+    for( int tile = mNextTile++; tile < tileCount; tile = mNextTile++ )
+    {
+        drawTile( tile );
+    }
+}
+
+void SoftRenderer::drawTile( int tile )
+{
+    SDL_Rect area;
+    area.x = ( tile % mTilesX ) * TILE_WIDTH;
+    area.y = ( tile / mTilesX ) * TILE_HEIGHT;
+    area.w = area.x + TILE_WIDTH > mWidth ? mWidth - area.x : TILE_WIDTH;
+    area.h = area.y + TILE_HEIGHT > mHeight ? mHeight - area.y : TILE_HEIGHT;
+
+    //Nothing under the last opaque command covering the tile shows
+    const vector<int>& bin = mBins[ tile ];
+    size_t first = 0;
+    for( size_t i = bin.size(); i > 0; --i )
+    {
+        const Command& command = mCommands[ bin[ i - 1 ] ];
+        bool opaque = command.type == Command::FILL || command.image->getCoverage() == SoftImage::COVERAGE_OPAQUE;
+        if( opaque && covers( command.dst, area ) )
+        {
+            first = i - 1;
+            break;
+        }
+    }
+
+    //Skip the tile if it would draw what it drew last frame
+    Uint64 hash = 14695981039346656037ull;
+    for( size_t i = first; i < bin.size(); ++i )
+    {
+        const Command& command = mCommands[ bin[ i ] ];
+        hashBytes( hash, &command.type, sizeof( command.type ) );
+        hashBytes( hash, &command.dst, sizeof( command.dst ) );
+        hashBytes( hash, &command.srcX, sizeof( command.srcX ) );
+        hashBytes( hash, &command.srcY, sizeof( command.srcY ) );
+        hashBytes( hash, &command.image, sizeof( command.image ) );
+        hashBytes( hash, &command.color, sizeof( command.color ) );
+        hashBytes( hash, &command.generation, sizeof( command.generation ) );
+    }
+    hash |= 1;
+
+    if( hash == mTileHashes[ tile ] )
+    {
+        mDirty[ tile ] = 0;
+        return;
+    }
+    mTileHashes[ tile ] = hash;
+    mDirty[ tile ] = 1;
+
+    for( size_t i = first; i < bin.size(); ++i )
+    {
+        const Command& command = mCommands[ bin[ i ] ];
+        SDL_Rect part;
+        if( !clipRect( command.dst, area, part ) )
+        {
+            continue;
+        }
+
+        Uint32* dst = &mFramebuffer[ part.y * mWidth + part.x ];
+        if( command.type == Command::FILL )
+        {
+            for( int y = 0; y < part.h; ++y, dst += mWidth )
+            {
+                fillRow( dst, part.w, command.color );
+            }
+            continue;
+        }
+
+        const SoftImage* image = command.image;
+        const Uint32* src = image->getPixels() + ( command.srcY + part.y - command.dst.y ) * image->getWidth() + command.srcX + part.x - command.dst.x;
+        for( int y = 0; y < part.h; ++y, dst += mWidth, src += image->getWidth() )
+        {
+            switch( image->getCoverage() )
+            {
+                case SoftImage::COVERAGE_OPAQUE: memcpy( dst, src, part.w * sizeof( Uint32 ) ); break;
+                case SoftImage::COVERAGE_KEYED: copyRowKeyed( dst, src, part.w ); break;
+                case SoftImage::COVERAGE_TRANSLUCENT: copyRowBlend( dst, src, part.w ); break;
+            }
+        }
+    }
+}
@@ -0,0 +1,178 @@
+/*
+CPU render backend for machines without a GPU.
+
+Draw calls are recorded for the frame, then binned into screen tiles that
+worker threads rasterize with SSE2 fills and blits. A tile is skipped when
+its commands match the previous frame, and drawing in a tile starts at the
+last opaque command that covers it, so clears and overdraw beneath the
+background are never touched. Finished rows are uploaded to a streaming
+SDL_Texture and copied to the window's renderer.
+*/
+
+#ifndef SOFTRENDER_H
+#define SOFTRENDER_H
+
+#include <SDL.h>
+#include <atomic>
+#include <vector>
+
+//Image in the framebuffer's ARGB8888 format
+class SoftImage
+{
+    public:
+        //How the pixels need to be composited
+        enum Coverage
+        {
+            COVERAGE_OPAQUE,
+            COVERAGE_KEYED,
+            COVERAGE_TRANSLUCENT
+        };
+
+        //Initializes variables
+        SoftImage();
+
+        //Copies a surface, its color key becomes transparent pixels
+        bool loadFromSurface( SDL_Surface* surface );
+
+        //Set color modulation
+        void setColor( Uint8 red, Uint8 green, Uint8 blue );
+
+        //Gets image dimensions
+        int getWidth() const;
+        int getHeight() const;
+
+        //Gets the modulated pixels
+        const Uint32* getPixels() const;
+
+        //Gets how the pixels composite
+        Coverage getCoverage() const;
+
+        //Changes every time the pixels do
+        Uint32 getGeneration() const;
+
+    private:
+        //Works out the coverage of mPixels
+        void classify();
+
+        //Pixels as loaded and after color modulation
+        std::vector<Uint32> mOriginal;
+        std::vector<Uint32> mPixels;
+
+        int mWidth;
+        int mHeight;
+
+        Coverage mCoverage;
+        Uint32 mGeneration;
+};
+
+//Tiled multithreaded software renderer
+class SoftRenderer
+{
+    public:
+        //Tile dimensions in pixels
+        static const int TILE_WIDTH = 128;
+        static const int TILE_HEIGHT = 64;
+
+        //Initializes variables
+        SoftRenderer();
+
+        //Stops the workers
+        ~SoftRenderer();
+
+        //Creates the framebuffer, the streaming texture on presenter and
+        //threads - 1 workers. threads <= 0 uses one per CPU
+        bool init( SDL_Renderer* presenter, int width, int height, int threads = 0 );
+
+        //Frees the framebuffer, texture and workers
+        void free();
+
+        //Fills the whole framebuffer
+        void clear( Uint8 red, Uint8 green, Uint8 blue );
+
+        //Fills a rectangle
+        void fillRect( const SDL_Rect& rect, Uint8 red, Uint8 green, Uint8 blue );
+
+        //Copies clip of image to x, y
+        void blit( const SoftImage* image, int x, int y, const SDL_Rect* clip = NULL );
+
+        //Rasterizes the recorded frame and copies it to the presenter
+        void flush();
+
+        //Gets the framebuffer
+        const Uint32* getPixels() const;
+        int getWidth() const;
+        int getHeight() const;
+
+        //Tiles redrawn by the last flush
+        int getDirtyTiles() const;
+
+    private:
+        //Recorded draw call
+        struct Command
+        {
+            enum Type
+            {
+                FILL,
+                BLIT
+            };
+
+            Type type;
+            SDL_Rect dst;
+            int srcX, srcY;
+            const SoftImage* image;
+            Uint32 color;
+            Uint32 generation;
+        };
+
+        //Worker thread entry point
+        static int workerThread( void* data );
+
+        //Takes tiles until there are none left
+        void drawTiles();
+
+        //Draws the commands binned to one tile
+        void drawTile( int tile );
+
+        //Recorded commands
+        std::vector<Command> mCommands;
+
+        //Command indices per tile
+        std::vector< std::vector<int> > mBins;
+
+        //What each tile drew last frame
+        std::vector<Uint64> mTileHashes;
+
+        //Tiles redrawn this frame
+        std::vector<Uint8> mDirty;
+
+        //ARGB8888 framebuffer
+        std::vector<Uint32> mFramebuffer;
+        int mWidth;
+        int mHeight;
+        int mTilesX;
+        int mTilesY;
+
+        //Streaming upload target
+        SDL_Renderer* mPresenter;
+        SDL_Texture* mTexture;
+
+        //Workers and the frame they are on
+        std::vector<SDL_Thread*> mWorkers;
+        SDL_mutex* mMutex;
+        SDL_cond* mStartCond;
+        SDL_cond* mDoneCond;
+        Uint32 mFrame;
+        int mBusyWorkers;
+
+        //Frame the workers were started on, so a flush() that comes before
+        //a worker first takes the mutex still counts as new to it
+        Uint32 mFirstFrame;
+        bool mQuit;
+
+        //Next tile to hand out
+        std::atomic<int> mNextTile;
+
+        int mDirtyTiles;
+};
+
+#endif
@@ -0,0 +1,305 @@
+/*
+Compares two harness reports and flags regressions.
+
+Usage: frame_regress <baseline.json> <candidate.json> [--p99-tolerance pct]
+                     [--min-delta ms] [--output file]
+
+Both reports come from runs of the same script and seed with --report. The
+candidate regresses when its p99 frame time grows by more than the
+tolerance (and by more than the minimum delta, so sub-microsecond noise on a
+fast frame doesn't count), or when a checked frame hashes differently from
+the baseline or no longer matches its golden image. The comparison is
+written as JSON and the exit code is 1 on a regression.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+using namespace std;
+
+//A checked frame from a report
+struct Snapshot
+{
+    string hash;
+    string golden;
+    unsigned diffPixels;
+};
+
+//The parts of a report the comparison needs
+struct Report
+{
+    string path;
+    string script;
+    string seed;
+    string build;
+    double meanMs;
+    double p50Ms;
+    double p90Ms;
+    double p99Ms;
+    double maxMs;
+    map<unsigned, Snapshot> snapshots;
+};
+
+//Text after "key": in a report, which writes one value per line
+static const char* findValue( const string& text, const char* key )
+{
+    string pattern = string( "\"" ) + key + "\":";
+    size_t at = text.find( pattern );
+    if( at == string::npos )
+    {
+        return NULL;
+    }
+
+    const char* value = text.c_str() + at + pattern.size();
+    while( *value == ' ' )
+    {
+        value++;
+    }
+    return value;
+}
+
+static double readNumber( const string& text, const char* key )
+{
+    const char* value = findValue( text, key );
+    return value != NULL ? strtod( value, NULL ) : 0.0;
+}
+
+//A value up to the end of its line as written, quotes included
+static string readRaw( const string& text, const char* key )
+{
+    const char* value = findValue( text, key );
+    if( value == NULL )
+    {
+        return "";
+    }
+
+    const char* end = strchr( value, '\n' );
+    string raw = end != NULL ? string( value, end ) : string( value );
+    while( !raw.empty() && ( raw[ raw.size() - 1 ] == ',' || raw[ raw.size() - 1 ] == '\r' ) )
+    {
+        raw.erase( raw.size() - 1 );
+    }
+    return raw;
+}
+
+//Writes a string with JSON escapes, same as harness.cpp
+static void writeJsonString( FILE* file, const string& text )
+{
+    fputc( '"', file );
+    for( size_t i = 0; i < text.size(); ++i )
+    {
+        char c = text[ i ];
+        if( c == '"' || c == '\\' )
+        {
+            fputc( '\\', file );
+            fputc( c, file );
+        }
+        else if( (unsigned char)c < 0x20 )
+        {
+            fprintf( file, "\\u%04x", c );
+        }
+        else
+        {
+            fputc( c, file );
+        }
+    }
+    fputc( '"', file );
+}
+
+bool readReport( const string& path, Report& report )
+{
+    FILE* file = fopen( path.c_str(), "rb" );
+    if( file == NULL )
+    {
+        printf( "Unable to open %s!\n", path.c_str() );
+        return false;
+    }
+
+    string text;
+    char buffer[ 4096 ];
+    size_t read;
+    while( ( read = fread( buffer, 1, sizeof( buffer ), file ) ) > 0 )
+    {
+        text.append( buffer, read );
+    }
+    fclose( file );
+
+    if( findValue( text, "p99_ms" ) == NULL )
+    {
+        printf( "%s is not a harness report!\n", path.c_str() );
+        return false;
+    }
+
+    report.path = path;
+    report.script = readRaw( text, "script" );
+    report.seed = readRaw( text, "seed" );
+    report.build = readRaw( text, "build" );
+    report.meanMs = readNumber( text, "mean_ms" );
+    report.p50Ms = readNumber( text, "p50_ms" );
+    report.p90Ms = readNumber( text, "p90_ms" );
+    report.p99Ms = readNumber( text, "p99_ms" );
+    report.maxMs = readNumber( text, "max_ms" );
+
+    //Snapshots are one object per line
+    size_t at = text.find( "\"snapshots\":" );
+    size_t end = text.find( ']', at );
+    while( at != string::npos && ( at = text.find( "{ \"frame\":", at ) ) != string::npos && at < end )
+    {
+        unsigned frame;
+        char hash[ 17 ] = "";
+        char golden[ 16 ] = "";
+        Snapshot snapshot;
+        if( sscanf( text.c_str() + at, "{ \"frame\": %u, \"hash\": \"%16[0-9a-f]\", \"golden\": \"%15[a-z]\", \"diff_pixels\": %u", &frame, hash, golden, &snapshot.diffPixels ) == 4 )
+        {
+            snapshot.hash = hash;
+            snapshot.golden = golden;
+            report.snapshots[ frame ] = snapshot;
+        }
+        at++;
+    }
+
+    return true;
+}
+
+//One timing row of the comparison
+void writeTiming( FILE* out, const char* name, double baseline, double candidate, bool regression, bool last )
+{
+    double change = baseline > 0.0 ? ( candidate - baseline ) * 100.0 / baseline : 0.0;
+    fprintf( out, "    \"%s\": { \"baseline\": %.4f, \"candidate\": %.4f, \"change_pct\": %.2f%s }%s\n", name, baseline, candidate, change, regression ? ", \"regression\": true" : "", last ? "" : "," );
+}
+
+int main( int argc, char* args[] )
+{
+    const char* paths[ 2 ] = { NULL, NULL };
+    const char* outputPath = NULL;
+    double tolerance = 10.0;
+    double minDelta = 0.05;
+    int count = 0;
+    for( int i = 1; i < argc; ++i )
+    {
+        string arg = args[ i ];
+        if( arg == "--p99-tolerance" && i + 1 < argc )
+        {
+            tolerance = atof( args[ ++i ] );
+        }
+        else if( arg == "--min-delta" && i + 1 < argc )
+        {
+            minDelta = atof( args[ ++i ] );
+        }
+        else if( arg == "--output" && i + 1 < argc )
+        {
+            outputPath = args[ ++i ];
+        }
+        else if( count < 2 && arg[ 0 ] != '-' )
+        {
+            paths[ count++ ] = args[ i ];
+        }
+        else
+        {
+            count = 0;
+            break;
+        }
+    }
+
+    if( count != 2 )
+    {
+        printf( "Usage: %s <baseline.json> <candidate.json> [--p99-tolerance pct] [--min-delta ms] [--output file]\n", args[ 0 ] );
+        return 2;
+    }
+
+    Report baseline, candidate;
+    if( !readReport( paths[ 0 ], baseline ) || !readReport( paths[ 1 ], candidate ) )
+    {
+        return 2;
+    }
+
+    //Different scripts or seeds don't measure the same frames
+    bool comparable = baseline.script == candidate.script && baseline.seed == candidate.seed;
+    if( !comparable )
+    {
+        fprintf( stderr, "Reports come from different scripts or seeds, only golden images are checked\n" );
+    }
+
+    double p99Delta = candidate.p99Ms - baseline.p99Ms;
+    bool timeRegression = comparable && p99Delta > minDelta && p99Delta > baseline.p99Ms * tolerance / 100.0;
+
+    FILE* out = outputPath != NULL ? fopen( outputPath, "w" ) : stdout;
+    if( out == NULL )
+    {
+        printf( "Unable to open %s!\n", outputPath );
+        return 2;
+    }
+
+    fprintf( out, "{\n" );
+    const Report* reports[ 2 ] = { &baseline, &candidate };
+    const char* names[ 2 ] = { "baseline", "candidate" };
+    for( int i = 0; i < 2; ++i )
+    {
+        fprintf( out, "  \"%s\": { \"report\": ", names[ i ] );
+        writeJsonString( out, reports[ i ]->path );
+        fprintf( out, ", \"build\": %s },\n", reports[ i ]->build.empty() ? "\"\"" : reports[ i ]->build.c_str() );
+    }
+    fprintf( out, "  \"comparable\": %s,\n", comparable ? "true" : "false" );
+    fprintf( out, "  \"p99_tolerance_pct\": %.2f,\n", tolerance );
+    fprintf( out, "  \"frame_time\": {\n" );
+    writeTiming( out, "mean_ms", baseline.meanMs, candidate.meanMs, false, false );
+    writeTiming( out, "p50_ms", baseline.p50Ms, candidate.p50Ms, false, false );
+    writeTiming( out, "p90_ms", baseline.p90Ms, candidate.p90Ms, false, false );
+    writeTiming( out, "p99_ms", baseline.p99Ms, candidate.p99Ms, timeRegression, false );
+    writeTiming( out, "max_ms", baseline.maxMs, candidate.maxMs, false, true );
+    fprintf( out, "  },\n" );
+
+    //Frames that changed against the baseline build or the golden images
+    vector<string> visual;
+    for( map<unsigned, Snapshot>::iterator it = candidate.snapshots.begin(); it != candidate.snapshots.end(); ++it )
+    {
+        char line[ 256 ];
+        map<unsigned, Snapshot>::iterator old = baseline.snapshots.find( it->first );
+        if( it->second.golden == "mismatch" || it->second.golden == "unreadable" )
+        {
+            snprintf( line, sizeof( line ), "{ \"frame\": %u, \"reason\": \"golden %s\", \"diff_pixels\": %u }", it->first, it->second.golden.c_str(), it->second.diffPixels );
+            visual.push_back( line );
+        }
+        else if( comparable && old != baseline.snapshots.end() && old->second.hash != it->second.hash )
+        {
+            snprintf( line, sizeof( line ), "{ \"frame\": %u, \"reason\": \"hash differs from baseline\", \"baseline_hash\": \"%s\", \"candidate_hash\": \"%s\" }", it->first, old->second.hash.c_str(), it->second.hash.c_str() );
+            visual.push_back( line );
+        }
+    }
+
+    //A frame the baseline checked that the candidate never reached
+    if( comparable )
+    {
+        for( map<unsigned, Snapshot>::iterator it = baseline.snapshots.begin(); it != baseline.snapshots.end(); ++it )
+        {
+            if( candidate.snapshots.find( it->first ) == candidate.snapshots.end() )
+            {
+                char line[ 128 ];
+                snprintf( line, sizeof( line ), "{ \"frame\": %u, \"reason\": \"missing from candidate\" }", it->first );
+                visual.push_back( line );
+            }
+        }
+    }
+
+    fprintf( out, "  \"visual_regressions\": [\n" );
+    for( size_t i = 0; i < visual.size(); ++i )
+    {
+        fprintf( out, "    %s%s\n", visual[ i ].c_str(), i + 1 < visual.size() ? "," : "" );
+    }
+    fprintf( out, "  ],\n" );
+
+    bool regression = timeRegression || !visual.empty();
+    fprintf( out, "  \"frame_time_regression\": %s,\n", timeRegression ? "true" : "false" );
+    fprintf( out, "  \"regression\": %s\n", regression ? "true" : "false" );
+    fprintf( out, "}\n" );
+
+    if( out != stdout )
+    {
+        fclose( out );
+    }
+
+    return regression ? 1 : 0;
+}
@@ -0,0 +1,207 @@
+/*
+Aggregate statistics over a directory of match-analytics logs.
+
+Usage: pma_stats <directory|file.pma>...
+
+Only the columns the statistics need are decoded, the rest are skipped by
+their byte length.
+*/
+
+#include "../matchlog.h"
+
+#include <dirent.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+using namespace std;
+
+//Contact offset histogram covers the paddle in 10 pixel buckets
+const int OFFSET_BUCKET = 10;
+const int OFFSET_BUCKETS = 14;
+
+//Totals over every log read
+struct Stats
+{
+    uint64_t files;
+    uint64_t groups;
+    uint64_t events;
+    uint64_t typeCounts[ EVENT_TYPE_COUNT ];
+    uint64_t points[ 3 ];
+
+    //Rally lengths from point events
+    uint64_t rallyTotal;
+    int32_t rallyMax;
+
+    //Paddle hits
+    double offsetTotal;
+    double speedTotal;
+    uint64_t offsetHistogram[ OFFSET_BUCKETS ];
+};
+
+//Columns the statistics read
+const bool WANTED_COLUMNS[ COLUMN_COUNT ] =
+{
+    false,  //tick
+    true,   //type
+    true,   //player
+    false,  //ball x
+    false,  //ball y
+    true,   //ball x velocity
+    true,   //ball y velocity
+    true,   //contact offset
+    true    //rally length
+};
+
+//Histogram bucket of a contact offset
+static int offsetBucket( int32_t offset )
+{
+    //Round towards negative infinity so -1 and 1 land in different buckets
+    int bucket = offset >= 0 ? offset / OFFSET_BUCKET : -( ( -offset + OFFSET_BUCKET - 1 ) / OFFSET_BUCKET );
+    bucket += OFFSET_BUCKETS / 2;
+    return bucket < 0 ? 0 : bucket >= OFFSET_BUCKETS ? OFFSET_BUCKETS - 1 : bucket;
+}
+
+bool readLog( const string& path, Stats& stats )
+{
+    FILE* file = fopen( path.c_str(), "rb" );
+    if( file == NULL )
+    {
+        printf( "Unable to open %s!\n", path.c_str() );
+        return false;
+    }
+
+    MatchLogHeader header;
+    if( fread( &header, sizeof( header ), 1, file ) != 1 || header.magic != MATCHLOG_MAGIC || header.version != MATCHLOG_VERSION )
+    {
+        printf( "%s is not a match log!\n", path.c_str() );
+        fclose( file );
+        return false;
+    }
+    stats.files++;
+
+    vector<int32_t> columns[ COLUMN_COUNT ];
+    vector<uint8_t> scratch;
+    MatchLogGroupHeader group;
+    while( matchLogReadGroup( file, group ) )
+    {
+        for( int i = 0; i < COLUMN_COUNT; ++i )
+        {
+            columns[ i ].clear();
+        }
+
+        bool complete = true;
+        for( uint32_t i = 0; i < group.columnCount && complete; ++i )
+        {
+            MatchLogColumnHeader column;
+            complete = matchLogReadColumn( file, group.rowCount, WANTED_COLUMNS, column, columns, scratch );
+        }
+
+        //Every wanted column has to be there
+        for( int i = 0; i < COLUMN_COUNT && complete; ++i )
+        {
+            complete = !WANTED_COLUMNS[ i ] || columns[ i ].size() == group.rowCount;
+        }
+
+        if( !complete )
+        {
+            printf( "%s ends in a partial row group\n", path.c_str() );
+            break;
+        }
+
+        stats.groups++;
+        stats.events += group.rowCount;
+        for( uint32_t row = 0; row < group.rowCount; ++row )
+        {
+            int32_t type = columns[ COLUMN_TYPE ][ row ];
+            if( type < 0 || type >= EVENT_TYPE_COUNT )
+            {
+                continue;
+            }
+            stats.typeCounts[ type ]++;
+
+            int32_t player = columns[ COLUMN_PLAYER ][ row ];
+            if( type == EVENT_POINT && player >= 1 && player <= 2 )
+            {
+                int32_t rally = columns[ COLUMN_RALLY_LENGTH ][ row ];
+                stats.points[ player ]++;
+                stats.rallyTotal += rally;
+                stats.rallyMax = rally > stats.rallyMax ? rally : stats.rallyMax;
+            }
+            else if( type == EVENT_PADDLE_HIT )
+            {
+                int32_t offset = columns[ COLUMN_CONTACT_OFFSET ][ row ];
+                double velX = columns[ COLUMN_BALL_VEL_X ][ row ];
+                double velY = columns[ COLUMN_BALL_VEL_Y ][ row ];
+                stats.offsetTotal += offset < 0 ? -offset : offset;
+                stats.speedTotal += sqrt( velX * velX + velY * velY );
+                stats.offsetHistogram[ offsetBucket( offset ) ]++;
+            }
+        }
+    }
+
+    fclose( file );
+    return true;
+}
+
+//Reads every .pma file in a directory
+void readDirectory( const string& path, Stats& stats )
+{
+    DIR* dir = opendir( path.c_str() );
+    if( dir == NULL )
+    {
+        //Not a directory, treat it as a log
+        readLog( path, stats );
+        return;
+    }
+
+    dirent* entry;
+    while( ( entry = readdir( dir ) ) != NULL )
+    {
+        string name = entry->d_name;
+        if( name.size() > 4 && name.compare( name.size() - 4, 4, ".pma" ) == 0 )
+        {
+            readLog( path + "/" + name, stats );
+        }
+    }
+
+    closedir( dir );
+}
+
+int main( int argc, char* args[] )
+{
+    if( argc < 2 )
+    {
+        printf( "Usage: %s <directory|file.pma>...\n", args[ 0 ] );
+        return 1;
+    }
+
+    Stats stats;
+    memset( &stats, 0, sizeof( stats ) );
+    for( int i = 1; i < argc; ++i )
+    {
+        readDirectory( args[ i ], stats );
+    }
+
+    uint64_t hits = stats.typeCounts[ EVENT_PADDLE_HIT ];
+    uint64_t points = stats.typeCounts[ EVENT_POINT ];
+
+    printf( "logs            %llu\n", (unsigned long long)stats.files );
+    printf( "row groups      %llu\n", (unsigned long long)stats.groups );
+    printf( "events          %llu\n", (unsigned long long)stats.events );
+    printf( "paddle hits     %llu\n", (unsigned long long)hits );
+    printf( "wall bounces    %llu\n", (unsigned long long)stats.typeCounts[ EVENT_WALL_BOUNCE ] );
+    printf( "points          %llu (player 1 %llu, player 2 %llu)\n", (unsigned long long)points, (unsigned long long)stats.points[ 1 ], (unsigned long long)stats.points[ 2 ] );
+    printf( "rally length    mean %.2f, max %d\n", points ? (double)stats.rallyTotal / points : 0.0, stats.rallyMax );
+    printf( "hit speed       mean %.2f px/tick\n", hits ? stats.speedTotal / hits : 0.0 );
+    printf( "contact offset  mean |%.2f| px\n", hits ? stats.offsetTotal / hits : 0.0 );
+
+    for( int i = 0; i < OFFSET_BUCKETS; ++i )
+    {
+        int low = ( i - OFFSET_BUCKETS / 2 ) * OFFSET_BUCKET;
+        printf( "  %4d..%4d  %llu\n", low, low + OFFSET_BUCKET - 1, (unsigned long long)stats.offsetHistogram[ i ] );
+    }
+
+    return 0;
+}
@@ -0,0 +1,11 @@
+TEMPLATE = app
+CONFIG += console c++11
+CONFIG -= app_bundle
+CONFIG -= qt
+
+SOURCES += \
+    pma_stats.cpp \
+    ../matchlog.cpp
+
+HEADERS += \
+    ../matchlog.h